@@ -0,0 +1,185 @@
+#!/bin/sh
+#
+#	Decode benchmark for encode_decoder.
+#
+#	Builds the generator, then for each instruction set and each
+#	output variant generates a decoder with {O BENCHMARK}, compiles
+#	its harness and runs it.  The time per decode of each opcode
+#	stream is gathered into one table per instruction set, so any
+#	change to the tree or the layouts can be judged by the numbers.
+#
+#	Usage:	bench/run.sh [set ...]
+#
+#	The instruction sets are:
+#
+#		avr	The I records of example/AVR_CPU.txt (Z 16).
+#		syn16	A synthetic set of 16 bit instructions.
+#		syn32	A synthetic set of 32 bit instructions.
+#
+#	All three are run when none is named.  The synthetic sets are
+#	prefix-free opcodes of uneven length, with some values left as
+#	illegal instructions.  The trace stream of each set is a mix of
+#	its instructions picked uniformly, their operand bits random.
+#
+#	The environment can set CC, CFLAGS (-O2 -march=native by
+#	default), DECODES (the calls made per stream) and KEEP (a
+#	directory to leave the generated files in).
+#
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2 -march=native}
+DECODES=${DECODES:-20000000}
+TRACE_OPS=100000
+
+ROOT=$( cd "$( dirname "$0" )/.." && pwd )
+if [ -n "$KEEP" ]; then
+	WORK=$KEEP
+	mkdir -p "$WORK" || exit 1
+else
+	WORK=$( mktemp -d ) || exit 1
+	trap 'rm -rf "$WORK"' EXIT INT TERM
+fi
+
+SETS=${*:-avr syn16 syn32}
+VARIANTS="table field4 invert packed unroll blocked arrays code trie flat"
+
+#
+#	The records for each variant, and the members its T type
+#	needs ahead of the name which every variant formats.
+#
+variant_records() {
+	case $1 in
+		table)		echo "" ;;
+		field4)		echo "{O FIELD 4}" ;;
+		invert)		echo "{O INVERT}" ;;
+		packed)		echo "{O PACKED}" ;;
+		unroll)		echo "{O UNROLL}" ;;
+		blocked)	echo "{O FIELD 4}{O LAYOUT BLOCKED}" ;;
+		arrays)		echo "{M ARRAYS}" ;;
+		code)		echo "{M CODE}" ;;
+		trie)		echo "{M TRIE}" ;;
+		flat)		echo "{M FLAT}" ;;
+	esac
+}
+variant_members() {
+	case $1 in
+		table)		echo "uint32_t mask; int jump;" ;;
+		field4|unroll|blocked)
+				echo "uint32_t mask; uint8_t shift; int jump;" ;;
+		invert)		echo "uint32_t mask, flip; int jump;" ;;
+		*)		echo "" ;;
+	esac
+}
+
+#
+#	synthetic bits count seed
+#
+#	Output I records for count prefix-free opcodes of bits bits,
+#	made by splitting a random opcode prefix in two until there are
+#	enough.  One in eight is then dropped to leave illegal opcodes.
+#
+synthetic() {
+	awk -v bits="$1" -v count="$2" -v seed="$3" 'BEGIN {
+		srand( seed );
+		leaf[ 0 ] = "";
+		n = 1;
+		while( n < count ) {
+			i = int( rand() * n );
+			if( length( leaf[ i ]) >= bits - 4 ) continue;
+			leaf[ n++ ] = leaf[ i ] "1";
+			leaf[ i ] = leaf[ i ] "0";
+		}
+		for( i = 0; i < n; i++ ) {
+			if( i % 8 == 7 ) continue;
+			p = leaf[ i ];
+			while( length( p ) < bits ) p = p "a";
+			printf( "{I %s i%d }\n", p, i );
+		}
+	}'
+}
+
+#
+#	trace spec bits
+#
+#	Output a binary trace (little endian, as {O TRACE} reads) of
+#	the first word of instructions picked at random from a spec.
+#
+trace() {
+	LC_ALL=C awk -v bits="$2" -v ops="$TRACE_OPS" '
+	/^{I / {
+		pattern[ n++ ] = $2;
+	}
+	END {
+		srand( 1 );
+		bytes = int(( bits + 7 ) / 8 );
+		for( k = 0; k < ops; k++ ) {
+			p = pattern[ int( rand() * n )];
+			v = 0;
+			for( j = 1; j <= bits; j++ ) {
+				c = substr( p, j, 1 );
+				v = v * 2 + (( c == "1" )? 1: (( c == "0" )? 0: int( rand() * 2 )));
+			}
+			for( j = 0; j < bytes; j++ ) {
+				printf( "%c", v % 256 );
+				v = int( v / 256 );
+			}
+		}
+	}' "$1"
+}
+
+#
+#	The generator itself.  The files are named relative to the
+#	work directory, as the generator takes everything after the
+#	first dot of the name it is given as the extension.
+#
+$CC -O2 -pthread -o "$WORK/encode_decoder" "$ROOT/encode_decoder.c" || exit 1
+cd "$WORK" || exit 1
+
+for set in $SETS; do
+	case $set in
+		avr)	bits=16
+			grep '^{I ' "$ROOT/example/AVR_CPU.txt" > $set.i ;;
+		syn16)	bits=16
+			synthetic 16 200 16 > $set.i ;;
+		syn32)	bits=32
+			synthetic 32 600 32 > $set.i ;;
+		*)	echo "Unknown instruction set '$set' (avr, syn16 or syn32)." >&2
+			exit 1 ;;
+	esac
+	trace $set.i $bits > $set.trace
+
+	echo
+	echo "$set: $( grep -c '^{I ' $set.i ) instructions of $bits bits, $CC $CFLAGS"
+	printf "%-10s %12s %12s %12s %12s\n" "variant" "exhaustive" "random" "trace" "trace p99"
+	for v in $VARIANTS; do
+		name=$set-$v
+		{
+			echo "{L C}"
+			echo "{BS}"
+			echo "#include <stdint.h>"
+			echo "#include <stddef.h>"
+			echo "typedef struct { $( variant_members $v ) const char *name; } decoder_t;"
+			echo "{B}"
+			echo "{Z $bits}"
+			echo "{W 1}"
+			echo "{E illegal}"
+			echo '{F "%"}'
+			echo "{O BENCHMARK}"
+			variant_records $v
+			cat $set.i
+		} > $name.txt
+		if ! ./encode_decoder $name.txt 2> $name.err; then
+			printf "%-10s %s\n" $v "not generated: $( tail -1 $name.err )"
+			continue
+		fi
+		if ! $CC $CFLAGS -DDECODER_BENCHMARK -DDECODER_BENCH_DECODES=$DECODES -o $name $name.c 2> $name.cc; then
+			printf "%-10s %s\n" $v "not compiled: $( head -1 $name.cc )"
+			continue
+		fi
+		./$name $set.trace | awk -v v=$v '
+			$1 == "exhaustive"	{ e = $3 }
+			$1 == "random"		{ r = $3 }
+			$1 == "trace"		{ t = $3; p = $6 }
+			END			{ printf( "%-10s %12s %12s %12s %12s\n", v, e? e: "-", r? r: "-", t? t: "-", p? p: "-" ) }'
+	done
+done
@@ -7,12 +7,28 @@
  *	mechanism to decode those instructions.
  *
  *	Usage:
- *		encode_decoder < input_stream > output_stream
+ *		encode_decoder [-j [n]] < input_stream > output_stream
  *	or
- *		encode_decoder input_file[.suffix]
+ *		encode_decoder [-j [n]] [--stats=json] input_file[.suffix]
+ *
+ *	With -j the tree is built by n threads (one per processor when
+ *	n is not given), subtrees being handed out on a work stealing
+ *	basis.  The output is the same as that of a serial build.
+ *
+ *	Given an input file the output files are written under a
+ *	temporary name and only renamed over the old ones when their
+ *	content has changed.  A hash of the input is kept in a .cache
+ *	file beside them and, while it still matches, the program
+ *	stops without building the decoder again.
+ *
+ *	With --stats=json the counts of nodes and leaves, the size of
+ *	the table, and the depths of the leaves (overall and for each
+ *	instruction) are written to the standard output as JSON.  This
+ *	needs an L record, so that the source goes to a file.
  */
 
 #include <stdio.h>
+#include <stdarg.h>
 
 /*
  *	The input stream has the following format definition.
@@ -28,7 +44,7 @@
  *	Record Commands:
  *
  *	Z	Provide the number of bits which define the size of an
- *		instruction (typically 8 or 16).
+ *		instruction (typically 8 or 16, at most 64).
  *
  * 			{Z 8}
  *
@@ -100,6 +116,251 @@
  * 		or
  * 			{W 2}			Index output
  *
+ *	O	Provide an option adjusting how the decoder is built or
+ *		output.  The option name is not case sensitive and may be
+ *		followed by a value:
+ *
+ *			{O FIELD n}		Allow decision nodes to extract
+ *						a field of up to n bits (8 if
+ *						not given) in one step.
+ *			{O LEVELS BYTES}	Pick the trie levels giving
+ *						the smallest arrays (default).
+ *			{O LEVELS LOADS}	Pick the trie levels giving
+ *						the fewest expected loads.
+ *			{O LEVELS n n ...}	Use trie levels of these
+ *						widths (top bits first).
+ *			{O SHARE}		Output identical subtrees
+ *						of the table once.
+ *			{O TRACE file}		Weight the instructions by
+ *						counting an opcode trace.
+ *			{O STRATEGY name}	How split bits are chosen:
+ *						BALANCE (default), ENTROPY,
+ *						LOOKAHEAD, EXACT or ALL.
+ *			{O OBJECTIVE name}	What the best tree is: ROWS,
+ *						MAXIMUM or AVERAGE (default)
+ *						walk.
+ *			{O CONSTEXPR}		Output C++ constexpr arrays
+ *						and find routine.
+ *			{O VALUE type}		Type of the next value array
+ *						in the ARRAYS mode.
+ *			{O PACKED [bits]}	Pack the table rows into 16
+ *						or 32 bit entries.
+ *			{O LAYOUT name}		Order of the table rows: DEPTH
+ *						(default), BREADTH, VEB,
+ *						BLOCKED or ALL.
+ *			{O INVERT}		Choose which branch of each
+ *						one bit node is the next row.
+ *			{O ALIGN}		Align the table to a cache
+ *						line.
+ *			{O CACHE line [row]}	Cache line and row sizes in
+ *						bytes (64 and 16).
+ *			{O UNROLL}		Output the table walk unrolled
+ *						with no loop or branches.
+ *			{O BATCH}		Output N_find_many() decoding
+ *						a batch in the ARRAYS mode.
+ *			{O PREDECODE}		Output a cache of the decoded
+ *						words of a program image.
+ *			{O OPERANDS}		Output extractors of the
+ *						operand letters.
+ *			{O DISPATCH [name]}	Output a threaded dispatch
+ *						skeleton: GOTO (default)
+ *						or TAIL.
+ *			{O FETCH}		Test later opcode words only
+ *						when needed, and fetch them
+ *						only when tested.
+ *			{O BENCHMARK}		Output a harness timing
+ *						N_find().
+ *
+ *		BALANCE splits the instructions most evenly.  ENTROPY splits
+ *		their share of the decoding (their weights, or the fraction
+ *		of opcodes decoding to each) most evenly.  LOOKAHEAD tries
+ *		every split two levels down, estimating the rest, and EXACT
+ *		finds the best possible subtree for lists of up to 10
+ *		instructions (using BALANCE above that).  Both aim for the
+ *		objective.  ALL builds the tree with each strategy and keeps
+ *		the best by the objective.  The rows, longest walk and
+ *		average walk of each tree built are reported.
+ *
+ *		With FIELD a node is picked whenever every instruction it
+ *		has to separate defines a run of untested bits, and the
+ *		values found fill more than half of the 2^n branches (all
+ *		of them without an E record).  Each row of the table then
+ *		becomes { [index,] mask, shift, jump, ... } where the
+ *		children of a node are a block of rows starting 'jump'
+ *		rows down, indexed by (opcode & mask) >> shift.  A leaf
+ *		still has a zero mask.  A routine N_find() walking the
+ *		table is output after it, expecting the type named by
+ *		the T record to use these member names.
+ *
+ *		With CONSTEXPR (which needs an L record of C++) the arrays
+ *		are output as constexpr std::array and N_find() is constexpr,
+ *		so constant opcodes are decoded at compile time.  The table
+ *		rows become a generated literal type N_row holding the walk
+ *		members and a value member of the T type, which then only
+ *		holds the F record values (as for the leaf array N[]).
+ *
+ *		With PACKED each table row is output as a single 16 or 32
+ *		bit entry of N_table[], with the F record values moved to
+ *		the leaf array N[].  A leaf has the top bit set and its leaf
+ *		number below.  Otherwise the entry holds the bit number, the
+ *		word (when W > 1), the field width less one (with FIELD) and
+ *		the jump.  Jumps which do not fit (or are negative) are found
+ *		in N_far[] instead.
+ *
+ *		With LAYOUT the blocks of children in the field layout
+ *		(which is used for any layout but DEPTH, even without FIELD)
+ *		are output depth first, breadth first, in van Emde Boas
+ *		order, or packed into cache lines top down (BLOCKED), with
+ *		padding rows so no block straddles a line.  ALL measures
+ *		each and keeps the one reading the fewest cache lines per
+ *		decode (weighted, or by the share of opcodes decoding to
+ *		each leaf).  With INVERT each one bit row gains a 'flip'
+ *		member and the walk becomes
+ *
+ *			p += (( op & p->mask ) ^ p->flip )? p->jump: 1;
+ *
+ *		so either branch can be the next row, and each is picked
+ *		to cut the cache lines read.  The lines read per decode
+ *		are reported for any of these options.
+ *
+ *		With UNROLL (which uses the field layout, even without
+ *		FIELD) N_find() is output as one step per level of the tree,
+ *
+ *			ptr += ptr->jump + (( op & ptr->mask ) >> ptr->shift );
+ *
+ *		repeated with no loop or test.  A leaf row has a zero mask
+ *		and jump, so a walk reaching it early stays put for the
+ *		steps left.  The fixed cost (the number of dependent loads)
+ *		is reported and noted in the output.  It cannot be packed.
+ *
+ *		With PREDECODE a cache of what N_find() returns for each
+ *		address of a program image follows the decoder (N_find()
+ *		is then output for the one bit table too).  The caller
+ *		gives the storage to N_cache_init(), and N_cache_find()
+ *		fills each slot on first use (N_cache_load() fills them
+ *		all) along with the instruction's length in words, from
+ *		N_words[].  N_cache_invalidate( cache, address, count )
+ *		empties the slots a write to the image can change.
+ *
+ *		With OPERANDS each letter of each I record gets an inline
+ *		extractor N_name_letter() returning the bits so marked,
+ *		those of the first word being the most significant.  The
+ *		runs of bits are merged by shifts and masks, or by pext
+ *		when compiled for BMI2.  A structure N_operands has a member
+ *		for every letter used, and N_find_operands( opcode, ops )
+ *		fills in those of the instruction it finds (the opcode
+ *		pointing at all of its words).
+ *
+ *		With DISPATCH the decoder is followed by N_leaf( opcode ),
+ *		giving the leaf number found, and N_run() which dispatches
+ *		opcodes to a handler stub for each leaf until one returns.
+ *		The user defines N_FETCH() giving the next opcode, and
+ *		N_EXECUTE( handler, leaf ) doing the work of a handler,
+ *		which is given the instruction's first F record value.
+ *		N_PARAMS and N_ARGS (void and nothing by default) pass the
+ *		interpreter state along.  GOTO makes each stub a label of
+ *		N_run() reached by 'goto *label[ leaf ]' (or a switch where
+ *		labels as values are not supported), and TAIL makes it a
+ *		routine N_do_name() reached through N_handlers[] by a tail
+ *		call, marked musttail where the compiler supports it.
+ *
+ *		With FETCH (which needs W > 1 and the table or arrays mode)
+ *		each split is chosen from the first opcode word able to make
+ *		one, so a later word is tested only where the earlier words
+ *		cannot tell the instructions apart.  N_find_fetch( fetch,
+ *		context ) follows the decoder, reading each word through
+ *		'fetch( context, index )' the first time the walk tests it,
+ *		and N_words[] gives the length of the instruction found at
+ *		each table row (or leaf number).  The average number of
+ *		words read per decode is reported.
+ *
+ *		With BENCHMARK a harness follows the decoder, compiled in
+ *		by defining N_BENCHMARK.  Its main() times N_find() over
+ *		every opcode (for a W record of 1 and a word size of at
+ *		most 24), over uniformly random opcodes and over a trace
+ *		file named on its command line (as for {O TRACE}, later
+ *		words being random).  Each stream reports ns per decode,
+ *		decodes per second, and the median and 99th percentile
+ *		of the time per decode over blocks of N_BENCH_BLOCK calls.
+ *		bench/run.sh builds and runs the harness of every output
+ *		mode for a few instruction sets and tabulates the results.
+ *
+ *		With SHARE identical subtrees are folded together after the
+ *		tree is built.  In the one bit table a node already output
+ *		is jumped to rather than repeated (only the zero branch,
+ *		being the next row, is ever copied).  In the field layout a
+ *		node's block of children is output once, whichever blocks
+ *		the node appears in.  Either way a jump can be negative, so
+ *		its type must be signed.  The rows saved are reported.
+ *		Other layouts (and the unrolled walk) would give the blocks
+ *		rows again by their own order, so SHARE needs the DEPTH
+ *		layout and no UNROLL.
+ *
+ *	M	Select the form in which the decoder is output:
+ *
+ *			{M TABLE}		The decision table (default)
+ *			{M FLAT}		A direct lookup table
+ *			{M TRIE}		A multi-level lookup table
+ *			{M CODE}		Nested if and switch statements
+ *			{M ARRAYS}		Separate node and value arrays
+ *
+ *		FLAT needs a W record of 1 and a word size of no more than
+ *		24 bits (a warning is given above 16).  Every possible opcode
+ *		is decoded through the tree to give an array N_index[] of
+ *		leaf numbers, using the narrowest type which fits.  This
+ *		indexes a second array N[] of the type named by the T record
+ *		holding just the values formatted by the F records.  Leaf
+ *		zero is the error handler and the instructions follow in
+ *		input order.  The routine N_find() returning the leaf for
+ *		an opcode is output after the arrays.
+ *
+ *		TRIE also needs a W record of 1.  The opcode is cut into
+ *		up to four levels (top bits first) of at most 16 bits, each
+ *		output as an array N_level1[], N_level2[] ... of pages.  An
+ *		entry is either a leaf number, flagged by the top bit of its
+ *		type, or the offset of a page in the next level.  Identical
+ *		pages are only output once.  Unless the widths are given
+ *		every split is tried (in steps of 4 bits above 16 bit words)
+ *		and the smallest, or the one with the fewest expected loads,
+ *		is used.  Both are reported on stderr.
+ *
+ *		CODE outputs the tree as the body of N_find() instead of
+ *		as a table, returning a pointer into the same N[] array.
+ *		A one bit test becomes an if statement and a field test a
+ *		switch statement, with values leading to the same subtree
+ *		sharing their case labels.
+ *
+ *		ARRAYS outputs only the decision nodes, as the arrays
+ *		N_bit[], N_word[] (W > 1) and, with FIELD, N_mask[] and
+ *		N_base[].  Their children are in N_child[], a node number
+ *		or a flagged leaf number.  Each F record gives a separate
+ *		array of values N_value1[], N_value2[] ... indexed by leaf
+ *		number, named by a generated enum N_id which N_find()
+ *		returns.
+ *
+ *		With BATCH (and a W record of 1) the routine
+ *
+ *			N_find_many( const word *opcode, size_t count,
+ *					enum N_id *leaf )
+ *
+ *		decodes a whole array, walking 16 opcodes in lock step
+ *		with AVX-512 gathers, 8 with AVX2, or else interleaving 8
+ *		scalar walks, chosen at run time.  The node arrays are
+ *		padded so a 32 bit gather of their last entry is safe.
+ *
+ *	R	Provide the relative execution frequency of the named
+ *		instruction(s), used as a weight when building the tree.
+ *
+ *			{R ldi 1200}
+ *
+ *		The trace file given by {O TRACE file} is added in the same
+ *		way; it holds the first word of each instruction executed,
+ *		the word size rounded up to whole bytes, least significant
+ *		byte first.  With weights the single bit splits are chosen
+ *		to minimise the weighted depth of the tree rather than to
+ *		balance the instruction counts, and the expected walk
+ *		against that of the unweighted tree is reported.
+ *
  * 	[space]
  * 	[tab]	Content of the record is passed through to the output "as is"
  * 		before the content of the table is generated.
@@ -160,6 +421,9 @@
 #define ERROR_RECORD		'E'
 #define WORDS_RECORD		'W'
 #define HEADER_RECORD		'H'
+#define OPTION_RECORD		'O'
+#define MODE_RECORD		'M'
+#define RATE_RECORD		'R'
 
 #define BLOCK_RECORD		'B'
 #define BLOCK_START		'S'
@@ -205,10 +469,19 @@
 #define DUP(s) strdup(s)
 
 /*
- *	Define an internal type used to handle the bits bits.
+ *	Define an internal type used to handle the bits bits, wide
+ *	enough for any word size up to 64.
  */
 #include <stdint.h>
-typedef uint32_t word;
+#include <inttypes.h>
+typedef uint64_t word;
+#define WORD_BITS	((int)( sizeof( word ) << 3 ))
+
+/*
+ *	Numeric limits.
+ */
+#include <limits.h>
+#include <float.h>
 
 /*
  *	Define a logical value.
@@ -224,9 +497,14 @@ typedef int bool;
 #define MAX_CODES	16
 
 /*
- *	Define the largest input line we are happy to handle.
+ *	Define the size of the scratch buffers output text is built
+ *	in.  Buffers holding only numbers and fixed text are MAX_BUFFER
+ *	long.  Neither lines nor records have a length limit, so those
+ *	holding names or types (at most two of them) are taken from the
+ *	heap, sized from the longest name given (see new_text()).
  */
 #define MAX_BUFFER	256
+#define TEXT_BUFFER	( MAX_BUFFER + 2 * longest_name )
 
 /*
  *	Define the maximum number of formats which the program
@@ -234,6 +512,71 @@ typedef int bool;
  */
 #define MAX_FORMATS	8
 
+/*
+ *	Define the widest bit field which can be extracted by a
+ *	single decision node (giving 2^MAX_FIELD children).
+ */
+#define MAX_FIELD	8
+
+/*
+ *	Define the largest word size for which a flat table will be
+ *	output, and the size above which a warning is given.
+ */
+#define MAX_FLAT	24
+#define WARN_FLAT	16
+
+/*
+ *	Define the most levels a trie can be split into, and the
+ *	widest any one level can be.
+ */
+#define MAX_LEVELS	4
+#define MAX_PAGE	16
+
+/*
+ *	Define how many splits ahead the lookahead strategy looks, and
+ *	the longest list of instructions the exact strategy will solve.
+ */
+#define LOOKAHEAD	2
+#define MAX_EXACT	10
+
+/*
+ *	Define the shortest list of instructions whose subtree is worth
+ *	handing to another thread in a parallel build.
+ */
+#define MIN_TASK	16
+
+/*
+ *	Define the shortest list whose split bits are counted from bit
+ *	slices, 64 records at a time, rather than record by record.
+ */
+#define MIN_SLICE	64
+
+/*
+ *	Define the size of each block of an arena, and the alignment
+ *	of anything but strings allocated from one.
+ */
+#define ARENA_SIZE	65536
+#define ARENA_ALIGN	16
+
+/*
+ *	Define the 64 bit FNV-1a hash used to spot unchanged input
+ *	and output.
+ */
+#define HASH_START	0xCBF29CE484222325ULL
+#define HASH_PRIME	0x00000100000001B3ULL
+
+/*
+ *	Threads for the parallel build.
+ */
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ *	The input is mapped into memory where possible.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 /*
  *	Define the data structure used to capture a single instruction
  */
@@ -249,11 +592,13 @@ INSTRUCTION {
 	char		*name,				/* Given instruction name			*/
 			*comment;			/* Additional commentary provided		*/ 
 	int		elements;			/* Number of words forming the instruction	*/
-	word		opcode[ MAX_CODES ],		/* The instruction construction.		*/
-			mask[ MAX_CODES ];		/* Indicate those bits which are instruction	*/
-	char		*description[ MAX_CODES ];	/* Copy of the original bit description		*/
+	word		*opcode,			/* The instruction construction.		*/
+			*mask;				/* Indicate those bits which are instruction	*/
+	char		**description;			/* Copy of the original bit description		*/
 	int		matches;			/* How many versions of this instruction?	*/
-	word		unmatched[ MAX_CODES ];		/* The mask giving the bits that are undefined. */
+	int		id;				/* Leaf number (in input order, from 1)		*/
+	unsigned long	weight;				/* Relative frequency of execution		*/
+	word		*unmatched;			/* The mask giving the bits that are undefined. */
 	/*
 	 *	We will daisy chain the records together
 	 *	as a flexible mechanism for keeping them
@@ -262,6 +607,14 @@ INSTRUCTION {
 	INSTRUCTION	*next;
 };
 
+/*
+ *	The arrays of an instruction hold only the words it is made of
+ *	(at least one), so these give the defined bits and the opcode of
+ *	any word, those beyond the instruction defining nothing.
+ */
+#define MASK(p,i)	((( i ) < ( p )->elements )? ( p )->mask[ i ]: 0 )
+#define OPCODE(p,i)	((( i ) < ( p )->elements )? ( p )->opcode[ i ]: 0 )
+
 /*
  *	This is the data structure used to capture the decoding tree.
  */
@@ -289,12 +642,103 @@ NODE {
 	 *	If leaf FALSE...
 	 *
 	 *	then the follow data is used to distinguish between the
-	 *	two branches from this node.
+	 *	branches from this node.  A simple decision node tests a
+	 *	single bit (op_bits is 1) and has two children, a field
+	 *	node extracts op_bits contiguous bits (the lowest of which
+	 *	is op_bit) and has 2^op_bits children indexed by the value
+	 *	of the field.
 	 */
 	int		op_word,		/* Which instruction word are we comparing?	*/
-			op_bit;			/* Which bit in that word?			*/
-	NODE		*zero,
-			*one;
+			op_bit,			/* Which (lowest) bit in that word?		*/
+			op_bits;		/* How many bits are being tested?		*/
+	NODE		**child;		/* The 1 << op_bits branches from here.		*/
+	/*
+	 *	The start of the child array in the output table when
+	 *	the field table layout is in use.
+	 */
+	int		base;
+	/*
+	 *	Set when the one branch of a one bit node is the following
+	 *	row of the table and the zero branch is jumped to.
+	 */
+	bool		invert;
+};
+
+/*
+ *	Define the measures of a tree (or part of one) used to compare
+ *	different ways of building it.  Walks are counted in rows read,
+ *	including the leaf row.
+ */
+#define COST struct cost
+COST {
+	long		rows;			/* Rows of table used				*/
+	int		most;			/* The longest walk				*/
+	double		weight,			/* Total weight of the instructions		*/
+			sum;			/* Total of their walks times their weights	*/
+};
+
+/*
+ *	Define the statistics of a built tree reported by --stats=json.
+ *	Depths count the decision nodes tested to reach a leaf, so are
+ *	one less than the walks above.  Each instruction (by id) has
+ *	the least and most depth of its leaves, and the share of all
+ *	opcodes reaching them with the total of those shares times
+ *	their depths, giving its average over the opcodes decoding to
+ *	it.
+ */
+#define TREE_STATS struct tree_stats
+TREE_STATS {
+	int		nodes,			/* Decision nodes				*/
+			leaves,			/* Leaves decoding to an instruction		*/
+			errors,			/* Error leaves					*/
+			aliased,		/* Leaves decoding more than one opcode	*/
+			height;			/* The deepest leaf				*/
+	long		*found,			/* Instruction leaves at each depth		*/
+			*missed;		/* Error leaves at each depth			*/
+	double		expected;		/* Depth of a uniformly random opcode		*/
+	int		*least,			/* Shallowest leaf of each instruction		*/
+			*most;			/* Deepest leaf of each instruction		*/
+	double		*share,			/* Opcodes reaching each instruction		*/
+			*depth;			/* Their share times their depth		*/
+};
+
+/*
+ *	Shorthand for the two branches of a single bit decision node.
+ */
+#define ZERO(n)		((n)->child[ 0 ])
+#define ONE(n)		((n)->child[ 1 ])
+#define FALL(n)		((n)->child[( n )->invert? 1: 0 ])
+#define JUMP(n)		((n)->child[( n )->invert? 0: 1 ])
+
+/*
+ *	Define a record to hold the relative execution frequency given
+ *	for instructions of a name.
+ */
+#define RATE struct rate
+RATE {
+	int		line;
+	char		*name;
+	unsigned long	weight;
+	RATE		*next;
+};
+
+/*
+ *	Define a memory arena.  Allocations are carved off the front of
+ *	large blocks, and are only given back (all at once) at exit.
+ */
+#define ARENA struct arena
+ARENA {
+	char		*next,			/* Start of the space left in the block		*/
+			*end;			/* End of the block				*/
+};
+
+/*
+ *	Define the head of each arena block, linking together the blocks
+ *	of every arena so they can be released.
+ */
+#define ARENA_BLOCK struct arena_block
+ARENA_BLOCK {
+	ARENA_BLOCK	*prev;
 };
 
 /*
@@ -305,6 +749,7 @@ NODE {
 FINISH {
 	int	line;
 	char	*data;
+	size_t	length;
 	FINISH	*next;
 };
 
@@ -324,6 +769,33 @@ static char		*input_source_file = NULL,
 static FILE		*output_source = NULL,
 			*output_header = NULL;
 
+/*
+ *	Output files are written under a temporary name and only moved
+ *	over the real file when the content has changed.  The hash of
+ *	everything the output depends on is kept beside them in the
+ *	cache file so an unchanged input need not be built again.
+ */
+static char		*output_source_temp = NULL,
+			*output_header_temp = NULL,
+			*output_cache_name = NULL;
+static uint64_t		input_hash = HASH_START;
+
+/*
+ *	Memory arenas.  The records read from the input and the strings
+ *	(interned, so each is held once) are allocated while reading it,
+ *	and the nodes by each thread building the tree.  Nodes given back
+ *	are kept by size to be used again.
+ */
+static ARENA		record_arena = { NULL, NULL },
+			string_arena = { NULL, NULL };
+static _Thread_local ARENA	node_arena = { NULL, NULL };
+static _Thread_local NODE	*node_spare[ MAX_FIELD + 1 ];
+static ARENA_BLOCK	*arena_blocks = NULL;
+static pthread_mutex_t	arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static char		**intern_table = NULL;
+static int		intern_size = 0,
+			intern_used = 0;
+
 /*
  *	Define word size and enabled flag.
  */
@@ -337,6 +809,277 @@ static int		word_size = 0;
 static bool		maximum_words_set = FALSE;
 static int		maximum_words = MAX_CODES;
 
+/*
+ *	Define the widest bit field a single decision node is allowed
+ *	to extract.  A value of 1 gives the original one bit per row
+ *	binary table, anything larger selects the field table layout.
+ */
+static int		field_bits = 1;
+
+/*
+ *	Define the form the decoder is output in, with the names
+ *	used to select them (in the same order).
+ */
+static bool		output_mode_set = FALSE;
+static enum {
+	TABLE_OUTPUT,				/* Table of decision and leaf rows		*/
+	FLAT_OUTPUT,				/* Direct lookup of every possible opcode	*/
+	TRIE_OUTPUT,				/* Multi-level lookup with shared pages		*/
+	CODE_OUTPUT,				/* Nested switch and if statements		*/
+	ARRAYS_OUTPUT				/* Separate node, child and value arrays	*/
+} output_mode = TABLE_OUTPUT;
+static const char	*output_mode_name[] = {
+	"table",
+	"flat",
+	"trie",
+	"code",
+	"arrays",
+	NULL
+};
+
+/*
+ *	The options which can be given by an O record, with their
+ *	names (in the same order).
+ */
+enum {
+	FIELD_OPTION,				/* Widest field a node may test			*/
+	LEVELS_OPTION,				/* How a trie is split into levels		*/
+	SHARE_OPTION,				/* Output identical subtrees once		*/
+	TRACE_OPTION,				/* Weight instructions from an opcode trace	*/
+	STRATEGY_OPTION,			/* How the split bits are chosen		*/
+	OBJECTIVE_OPTION,			/* What the best tree is			*/
+	CONSTEXPR_OPTION,			/* Output C++ constexpr arrays and routines	*/
+	PACKED_OPTION,				/* Pack table rows into 16 or 32 bits		*/
+	VALUE_OPTION,				/* Type of the next F record's value array	*/
+	LAYOUT_OPTION,				/* Order of the rows of the table		*/
+	INVERT_OPTION,				/* Let the one branch be the following row	*/
+	ALIGN_OPTION,				/* Align the table to a cache line		*/
+	CACHE_OPTION,				/* Cache line and table row sizes		*/
+	UNROLL_OPTION,				/* Output the walk unrolled, without branches	*/
+	BATCH_OPTION,				/* Output a routine decoding many opcodes	*/
+	PREDECODE_OPTION,			/* Output a cache of decoded program words	*/
+	OPERANDS_OPTION,			/* Output extractors of the operand letters	*/
+	DISPATCH_OPTION,			/* Output a threaded dispatch skeleton		*/
+	FETCH_OPTION,				/* Fetch opcode words only when tested		*/
+	BENCHMARK_OPTION			/* Output a timing harness for N_find()		*/
+};
+static const char	*option_name[] = {
+	"field",
+	"levels",
+	"share",
+	"trace",
+	"strategy",
+	"objective",
+	"constexpr",
+	"packed",
+	"value",
+	"layout",
+	"invert",
+	"align",
+	"cache",
+	"unroll",
+	"batch",
+	"predecode",
+	"operands",
+	"dispatch",
+	"fetch",
+	"benchmark",
+	NULL
+};
+
+/*
+ *	Define the ways insert() can choose the bit which splits a
+ *	list of instructions, with their names (in the same order).
+ */
+static enum {
+	BALANCE_STRATEGY,			/* Most even split of the instructions		*/
+	ENTROPY_STRATEGY,			/* Most information about a random opcode	*/
+	LOOKAHEAD_STRATEGY,			/* Best result a few splits further on		*/
+	EXACT_STRATEGY,				/* Best possible result for short lists		*/
+	ALL_STRATEGIES				/* Try each of the above, keep the best		*/
+} split_strategy = BALANCE_STRATEGY;
+static const char	*strategy_name[] = {
+	"balance",
+	"entropy",
+	"lookahead",
+	"exact",
+	"all",
+	NULL
+};
+static bool		strategy_set = FALSE;
+
+/*
+ *	Define what makes one tree better than another, with the
+ *	names (in the same order).
+ */
+static enum {
+	ROWS_OBJECTIVE,				/* Fewest rows in the table			*/
+	MAXIMUM_OBJECTIVE,			/* Shortest longest walk			*/
+	AVERAGE_OBJECTIVE			/* Shortest average walk			*/
+} split_objective = AVERAGE_OBJECTIVE;
+static const char	*objective_name[] = {
+	"rows",
+	"maximum",
+	"average",
+	NULL
+};
+
+/*
+ *	Set when identical subtrees are to be output once, with every
+ *	parent jumping to the same block of rows.  This needs the field
+ *	table layout (and its signed jump) even with one bit nodes.
+ */
+static bool		share_subtrees = FALSE;
+
+/*
+ *	Set when the decoder is output as C++ constexpr arrays with a
+ *	constexpr routine to find the leaf, which needs C++ to have
+ *	been selected.
+ */
+static bool		constexpr_output = FALSE,
+			output_cpp = FALSE;
+
+/*
+ *	Set when the table rows are packed into entries of 16 or 32
+ *	bits (packed_bits, or whichever is best when 0).
+ */
+static bool		packed_output = FALSE;
+static int		packed_bits = 0;
+
+/*
+ *	Define the orders the rows of the table can be laid out in,
+ *	with their names (in the same order).  Other than DEPTH these
+ *	need the field table layout, which is then used whatever the
+ *	field width.
+ */
+static enum {
+	DEPTH_LAYOUT,				/* Depth first, as built			*/
+	BREADTH_LAYOUT,				/* A level at a time (Eytzinger)		*/
+	VEB_LAYOUT,				/* Recursively by height (van Emde Boas)	*/
+	BLOCKED_LAYOUT,				/* Subtrees packed into cache lines		*/
+	ALL_LAYOUTS				/* Try each of the above, keep the best		*/
+} table_layout = DEPTH_LAYOUT;
+static const char	*layout_name[] = {
+	"depth",
+	"breadth",
+	"veb",
+	"blocked",
+	"all",
+	NULL
+};
+static bool		layout_set = FALSE,
+			field_rows = FALSE,
+			invert_tests = FALSE,
+			align_table = FALSE;
+
+/*
+ *	The sizes (in bytes) of a cache line and of a table row, used
+ *	to lay out and measure the table.
+ */
+static int		cache_line = 64,
+			row_bytes = 16;
+
+/*
+ *	Set when the routine walking the table is output unrolled to
+ *	walk_steps steps (the height of the tree) with no loop.  This
+ *	needs the field table layout, where a leaf row jumps to itself.
+ */
+static bool		unroll_walk = FALSE;
+static int		walk_steps = 0;
+
+/*
+ *	Set when the arrays are followed by a routine decoding a batch
+ *	of opcodes, walking several at once (with AVX2 or AVX-512
+ *	gathers where the processor has them).
+ */
+static bool		batch_output = FALSE;
+
+/*
+ *	Set when a predecode cache, holding the decoded leaf and
+ *	instruction length at each address of a program image, is
+ *	output after the decoder.
+ */
+static bool		predecode_cache = FALSE;
+
+/*
+ *	Set when the operands marked by letters in the I records get
+ *	extractors, and a structure filled in by a lookup.
+ */
+static bool		operand_output = FALSE;
+
+/*
+ *	Set when splits test later opcode words only where the earlier
+ *	words cannot tell the instructions apart, and a routine reading
+ *	each word through a callback (only once a node tests it) and
+ *	the instruction lengths follow the decoder.
+ */
+static bool		lazy_fetch = FALSE;
+
+/*
+ *	Set when a harness timing N_find() over streams of opcodes,
+ *	compiled in by defining N_BENCHMARK, follows the decoder.
+ */
+static bool		benchmark_output = FALSE;
+
+/*
+ *	Set by --stats=json, when statistics of the tree and table are
+ *	written to the standard output.  Each form of output records
+ *	its name and size for them; a count of zero is not known (the
+ *	table rows being the user's T type, their size is taken from
+ *	the CACHE option).
+ */
+static bool		stats_output = FALSE;
+static const char	*table_form = "table";
+static long		table_entries = 0,
+			table_entry_bytes = 0,
+			table_bytes = 0;
+
+/*
+ *	The most words any instruction has, beyond which there is
+ *	nothing to split on.
+ */
+static int		split_words = MAX_CODES;
+
+/*
+ *	The length of the longest name or type read (see TEXT_BUFFER).
+ */
+static size_t		longest_name = 0;
+
+/*
+ *	Set once the array of instruction lengths has been output.
+ */
+static bool		words_output = FALSE;
+
+/*
+ *	Set once the fixed width integer types have been included.
+ */
+static bool		stdint_output = FALSE;
+
+/*
+ *	Define the forms of threaded dispatch skeleton which can follow
+ *	the decoder, with their names (in the same order).
+ */
+static enum {
+	NO_DISPATCH,				/* No skeleton					*/
+	GOTO_DISPATCH,				/* Labels as values, goto *label[ leaf ]	*/
+	TAIL_DISPATCH				/* Handler functions ending in tail calls	*/
+} dispatch_form = NO_DISPATCH;
+static const char	*dispatch_name[] = {
+	"none",
+	"goto",
+	"tail",
+	NULL
+};
+
+/*
+ *	Define how a trie is split into levels; either the widths are
+ *	given or they are chosen to minimise the size of the arrays (0)
+ *	or the expected number of loads (1).
+ */
+static int		trie_given = 0,
+			trie_width[ MAX_LEVELS ],
+			trie_objective = 0;
+
 /*
  *	Define the output formatting; a in front
  *	b afterwards.
@@ -345,6 +1088,13 @@ static int		output_formats = 0;
 static char		*output_format_a[ MAX_FORMATS ],
 			*output_format_b[ MAX_FORMATS ];
 
+/*
+ *	Define the types of the value arrays (one per F record) in the
+ *	arrays output mode, the T record type being used for the rest.
+ */
+static int		value_types = 0;
+static char		*value_type[ MAX_FORMATS ];
+
 /*
  *	Define the comment output formatting.
  */
@@ -370,17 +1120,46 @@ static char		*data_name = NULL;
 static FINISH		*finish_data = NULL,
 			**finish_data_tail = &( finish_data );
 
+/*
+ *	The run of pass through lines (still in the input text) waiting
+ *	to be written to the same output file in one go.
+ */
+static FILE		*pass_file = NULL;
+static char		*pass_data = NULL;
+static size_t		pass_length = 0;
+
 /*
  *	All the instructions can be found here.
  */
 static INSTRUCTION	*instructions = NULL,
 			**instruction_tail = &( instructions );
 
+/*
+ *	The execution frequencies given, applied once all of the
+ *	instructions have been read, and the name of a file holding
+ *	a trace of executed opcodes to count.
+ */
+static RATE		*rates = NULL,
+			**rate_tail = &( rates );
+static char		*trace_file = NULL;
+
+/*
+ *	Set when the weights are used to measure the walks, otherwise
+ *	every instruction counts the same.
+ */
+static bool		weighted = FALSE;
+
 /*
  *	The decode tree is found here
  */
 static NODE		*tree = NULL;
 
+/*
+ *	Set while building a tree only to measure it, so that any
+ *	problems are not reported twice.
+ */
+static bool		trial_build = FALSE;
+
 /*
  *	Instruction DROP count.
  */
@@ -464,6 +1243,16 @@ static bool isopcode( int c ) {
 	return(( c == ZERO_BIT )||( c == ONE_BIT )||( c == ARGUMENT_BIT )||( isalpha( c )));
 }
 
+/*
+ *	Remove every invisible character from a string in place.
+ */
+static void strip_spaces( char *s ) {
+	char	*p;
+
+	for( p = s; *s != EOS; s++ ) if( isvisible( *s )) *p++ = *s;
+	*p = EOS;
+}
+
 /*
  *	Output filename construction
  */
@@ -478,44 +1267,367 @@ static char *strcatdup( char *a, const char *b ) {
 }
 
 /*
- *	Process a line of input.
+ *	Add n bytes of data to the hash h.
  */
-static bool process( int line, char *input, char *comment ) {
-	char	record;
-	
-	switch(( record = *input++ )) {
-		case SIZE_RECORD: {
-			int	i;
+static uint64_t hash_bytes( uint64_t h, const void *data, size_t n ) {
+	const unsigned char *p = (const unsigned char *)data;
 
-			/*
-			 *	S nnn	Provide number of bits per word of instruction
-			 */
-			output_target = UNSPECIFIED_TARGET;
-			i = atoi( input );
-			if(( i <= 0 )||( i > ( sizeof( word ) << 3 ))) {
-				fprintf( stderr, "Line %d: Invalid word size %d.\n", line, i );
-				return( FALSE );
-			}
-			if( word_size_set ) {
-				fprintf( stderr, "Line %d: Cannot reset word size.\n", line );
-				return( FALSE );
-			}	
-			word_size = i;
-			word_size_set = TRUE;
-			break;
+	while( n-- ) {
+		h ^= *p++;
+		h *= HASH_PRIME;
+	}
+	return( h );
+}
+
+/*
+ *	Allocate size bytes (aligned to align, a power of two) from an
+ *	arena, starting a new block when there is not room in the last.
+ */
+static void *arena_alloc( ARENA *arena, size_t size, size_t align ) {
+	size_t		head = ( sizeof( ARENA_BLOCK ) + ARENA_ALIGN - 1 ) & ~(size_t)( ARENA_ALIGN - 1 ),
+			room;
+	ARENA_BLOCK	*block;
+	char		*p;
+
+	p = (char *)((((uintptr_t)arena->next ) + align - 1 ) & ~(uintptr_t)( align - 1 ));
+	if(( arena->next == NULL )||( p + size > arena->end )) {
+		room = ( size + head > ARENA_SIZE )? size + head: ARENA_SIZE;
+		if(( block = (ARENA_BLOCK *)malloc( room )) == NULL ) {
+			fprintf( stderr, "Out of memory.\n" );
+			exit( 1 );
 		}
-		case WORDS_RECORD: {
-			int	i;
+		pthread_mutex_lock( &arena_lock );
+		block->prev = arena_blocks;
+		arena_blocks = block;
+		pthread_mutex_unlock( &arena_lock );
+		p = (char *)block + head;
+		arena->end = (char *)block + room;
+	}
+	arena->next = p + size;
+	return( p );
+}
 
-			/*
-			 *	W nnn	Provide maximum number of words required to
-			 *		identify an instruction.
-			 */
-			output_target = UNSPECIFIED_TARGET;
-			i = atoi( input );
-			if(( i <= 0 )||( i > MAX_CODES )) {
-				fprintf( stderr, "Line %d: Invalid number of words %d.\n", line, i );
-				return( FALSE );
+/*
+ *	Give back the memory of every arena.
+ */
+static void release_arenas( void ) {
+	ARENA_BLOCK	*block;
+
+	while(( block = arena_blocks )) {
+		arena_blocks = block->prev;
+		FREE( block );
+	}
+	if( intern_table ) FREE( intern_table );
+	intern_table = NULL;
+}
+
+/*
+ *	Return the one copy (in the string arena) of a string.
+ */
+static char *intern( const char *s ) {
+	size_t	n = strlen( s ) + 1;
+	int	i;
+
+	if( intern_used * 2 >= intern_size ) {
+		char	**old = intern_table;
+		int	size = intern_size;
+
+		intern_size = ( size )? size << 1: 1024;
+		intern_table = (char **)malloc( sizeof( char * ) * intern_size );
+		for( i = 0; i < intern_size; intern_table[ i++ ] = NULL );
+		for( int j = 0; j < size; j++ ) {
+			if( old[ j ]) {
+				i = hash_bytes( HASH_START, old[ j ], strlen( old[ j ]) + 1 ) & ( intern_size - 1 );
+				while( intern_table[ i ]) i = ( i + 1 ) & ( intern_size - 1 );
+				intern_table[ i ] = old[ j ];
+			}
+		}
+		if( old ) FREE( old );
+	}
+	i = hash_bytes( HASH_START, s, n ) & ( intern_size - 1 );
+	while( intern_table[ i ]) {
+		if( strcmp( intern_table[ i ], s ) == 0 ) return( intern_table[ i ]);
+		i = ( i + 1 ) & ( intern_size - 1 );
+	}
+	intern_used++;
+	return( intern_table[ i ] = (char *)memcpy( arena_alloc( &string_arena, n, 1 ), s, n ));
+}
+
+/*
+ *	Return the one copy of a name or type which will be built into
+ *	the output, noting the longest (see TEXT_BUFFER).
+ */
+static char *intern_name( const char *s ) {
+	if( strlen( s ) > longest_name ) longest_name = strlen( s );
+	return( intern( s ));
+}
+
+/*
+ *	Return a new scratch buffer (n times TEXT_BUFFER long) for
+ *	output text holding names, to be released with FREE().
+ */
+static char *new_text( int n ) {
+	return(( char * )malloc( n * TEXT_BUFFER ));
+}
+
+/*
+ *	Add the content of a file to the hash h, returning FALSE if the
+ *	file cannot be read.
+ */
+static bool hash_file( const char *name, uint64_t *h ) {
+	char	buffer[ BUFSIZ ];
+	size_t	n;
+	FILE	*source;
+
+	if(( source = fopen( name, "rb" )) == NULL ) return( FALSE );
+	while(( n = fread( buffer, 1, BUFSIZ, source )) > 0 ) *h = hash_bytes( *h, buffer, n );
+	fclose( source );
+	return( TRUE );
+}
+
+/*
+ *	Open an output file under a temporary name beside the real
+ *	one, so the real file is only ever replaced whole.  mkstemp()
+ *	creates the file readable by its owner alone, so it is given
+ *	the mode of the file it will replace or, failing that, the
+ *	mode a new file would get under the umask.
+ */
+static FILE *open_output( const char *name, char **temp ) {
+	char		*t;
+	int		fd;
+	mode_t		mode;
+	struct stat	st;
+	FILE		*f;
+
+	t = strcatdup(( char * )name, ".XXXXXX" );
+	if(( fd = mkstemp( t )) < 0 ) {
+		FREE( t );
+		return( NULL );
+	}
+	if( stat( name, &st ) == 0 ) {
+		mode = st.st_mode & 07777;
+	}
+	else {
+		mode = umask( 0 );
+		umask( mode );
+		mode = 0666 & ~mode;
+	}
+	if( fchmod( fd, mode )) {
+		fprintf( stderr, "Unable to set the mode of file '%s'.\n", t );
+	}
+	if(( f = fdopen( fd, "w" )) == NULL ) {
+		close( fd );
+		unlink( t );
+		FREE( t );
+		return( NULL );
+	}
+	*temp = t;
+	return( f );
+}
+
+/*
+ *	Are two files byte for byte the same?
+ */
+static bool same_file( const char *a, const char *b ) {
+	char	ba[ BUFSIZ ],
+		bb[ BUFSIZ ];
+	size_t	na,
+		nb;
+	bool	same;
+	FILE	*fa,
+		*fb;
+
+	if(( fa = fopen( a, "rb" )) == NULL ) return( FALSE );
+	if(( fb = fopen( b, "rb" )) == NULL ) {
+		fclose( fa );
+		return( FALSE );
+	}
+	do {
+		na = fread( ba, 1, BUFSIZ, fa );
+		nb = fread( bb, 1, BUFSIZ, fb );
+		same = ( na == nb )&&( memcmp( ba, bb, na ) == 0 );
+	} while( same &&( na > 0 ));
+	fclose( fa );
+	fclose( fb );
+	return( same );
+}
+
+/*
+ *	Put a finished temporary output file in place of the real one,
+ *	leaving the real file untouched if nothing has changed.
+ */
+static bool commit_output( const char *name, char *temp ) {
+	if( same_file( temp, name )) {
+		unlink( temp );
+		return( TRUE );
+	}
+	if( rename( temp, name )) {
+		fprintf( stderr, "Unable to replace file '%s'.\n", name );
+		unlink( temp );
+		return( FALSE );
+	}
+	return( TRUE );
+}
+
+/*
+ *	Throw away any temporary output files which have not been
+ *	committed, for when the program stops early.
+ */
+static void discard_output( void ) {
+	if( output_header_temp ) unlink( output_header_temp );
+	if( output_source_temp ) unlink( output_source_temp );
+	output_header_temp = NULL;
+	output_source_temp = NULL;
+}
+
+/*
+ *	Does the cache file hold the input hash given, with both output
+ *	files still as they were written?
+ */
+static bool cache_current( uint64_t key ) {
+	unsigned long long	k,
+				h,
+				s;
+	uint64_t		hh,
+				hs;
+	FILE			*cache;
+	int			n;
+
+	if(( cache = fopen( output_cache_name, "r" )) == NULL ) return( FALSE );
+	n = fscanf( cache, "%llx %llx %llx", &k, &h, &s );
+	fclose( cache );
+	if(( n != 3 )||( k != key )) return( FALSE );
+	hh = HASH_START;
+	hs = HASH_START;
+	if( !hash_file( output_header_name, &hh ) || !hash_file( output_source_name, &hs )) return( FALSE );
+	return(( hh == h )&&( hs == s ));
+}
+
+/*
+ *	Record the input hash, and the output files it gave, in the
+ *	cache file.
+ */
+static void write_cache( uint64_t key ) {
+	uint64_t	hh,
+			hs;
+	FILE		*cache;
+
+	hh = HASH_START;
+	hs = HASH_START;
+	if( !hash_file( output_header_name, &hh ) || !hash_file( output_source_name, &hs )) return;
+	if(( cache = fopen( output_cache_name, "w" )) == NULL ) {
+		fprintf( stderr, "Unable to write cache file '%s'.\n", output_cache_name );
+		return;
+	}
+	fprintf( cache, "%016llx %016llx %016llx\n", (unsigned long long)key, (unsigned long long)hh, (unsigned long long)hs );
+	fclose( cache );
+}
+
+/*
+ *	Bring the whole input into memory, mapping it where we can and
+ *	reading it in where we cannot (a pipe, or a file whose last line
+ *	has no new line).  Lines are edited in place, so the mapping is
+ *	private.  Either way every line ends with a new line, and read
+ *	in text is followed by an EOS.
+ */
+static char *load_input( FILE *input, size_t *size ) {
+	struct stat	info;
+	char		*text;
+	size_t		have,
+			room,
+			got;
+
+	if(( fstat( fileno( input ), &info ) == 0 )&& S_ISREG( info.st_mode )&&( info.st_size > 0 )) {
+		text = (char *)mmap( NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno( input ), 0 );
+		if( text != MAP_FAILED ) {
+			if( text[ info.st_size - 1 ] == NL ) {
+				*size = info.st_size;
+				return( text );
+			}
+			munmap( text, info.st_size );
+		}
+	}
+	have = 0;
+	room = BUFSIZ;
+	if(( text = (char *)malloc( room + 2 )) == NULL ) return( NULL );
+	while(( got = fread( text + have, 1, room - have, input )) > 0 ) {
+		if(( have += got ) == room ) {
+			if(( text = (char *)realloc( text, ( room <<= 1 ) + 2 )) == NULL ) return( NULL );
+		}
+	}
+	if( ferror( input )) {
+		FREE( text );
+		return( NULL );
+	}
+	if( have &&( text[ have-1 ] != NL )) text[ have++ ] = NL;
+	text[ have ] = EOS;
+	*size = have;
+	return( text );
+}
+
+/*
+ *	Write out the run of pass through lines waiting.
+ */
+static void flush_pass( void ) {
+	if( pass_file ) {
+		fwrite( pass_data, 1, pass_length, pass_file );
+		pass_file = NULL;
+	}
+}
+
+/*
+ *	Add a pass through line (with its new line) to the run waiting,
+ *	first writing out the run if the line does not follow on from it.
+ */
+static void pass_line( FILE *output, char *data, size_t length ) {
+	if(( output != pass_file )||( data != pass_data + pass_length )) {
+		flush_pass();
+		pass_file = output;
+		pass_data = data;
+		pass_length = 0;
+	}
+	pass_length += length;
+}
+
+/*
+ *	Process a line of input.
+ */
+static bool process( int line, char *input, char *comment ) {
+	char	record;
+	
+	switch(( record = *input++ )) {
+		case SIZE_RECORD: {
+			int	i;
+
+			/*
+			 *	S nnn	Provide number of bits per word of instruction
+			 */
+			output_target = UNSPECIFIED_TARGET;
+			i = atoi( input );
+			if(( i <= 0 )||( i > ( sizeof( word ) << 3 ))) {
+				fprintf( stderr, "Line %d: Invalid word size %d.\n", line, i );
+				return( FALSE );
+			}
+			if( word_size_set ) {
+				fprintf( stderr, "Line %d: Cannot reset word size.\n", line );
+				return( FALSE );
+			}	
+			word_size = i;
+			word_size_set = TRUE;
+			break;
+		}
+		case WORDS_RECORD: {
+			int	i;
+
+			/*
+			 *	W nnn	Provide maximum number of words required to
+			 *		identify an instruction.
+			 */
+			output_target = UNSPECIFIED_TARGET;
+			i = atoi( input );
+			if(( i <= 0 )||( i > MAX_CODES )) {
+				fprintf( stderr, "Line %d: Invalid number of words %d.\n", line, i );
+				return( FALSE );
 			}
 			if( maximum_words_set ) {
 				fprintf( stderr, "Line %d: Cannot reset number of words.\n", line );
@@ -525,215 +1637,447 @@ static bool process( int line, char *input, char *comment ) {
 			maximum_words_set = TRUE;
 			break;
 		}
-		case FORMAT_RECORD: {
-			char	*p, *q, *r;
-			
+		case MODE_RECORD: {
+			int	i;
+
 			/*
-			 *	F ffff[%ffff]
+			 *	M mode		Select the form of the decoder.
 			 */
 			output_target = UNSPECIFIED_TARGET;
-			if( output_formats >= MAX_FORMATS ) {
-				fprintf( stderr, "Line %d: Too many output formats specified (maximum is %d).\n", line, MAX_FORMATS );
+			strip_spaces( input );
+			if( output_mode_set ) {
+				fprintf( stderr, "Line %d: Cannot reset output mode.\n", line );
 				return( FALSE );
 			}
-			/*
-			 *	Strip spaces...
-			 */
-			p = input;
-			while( *p != EOS ) {
-				if( isvisible( *p )) {
-					p++;
-				}
-				else {
-					/*
-					 *	Roll out the white space.
-					 */
-					q = p;
-					r = p+1;
-					while(( *q++ = *r++ ));
-				}
+			for( i = 0; output_mode_name[ i ]; i++ ) {
+				if( strcasecmp( input, output_mode_name[ i ]) == 0 ) break;
 			}
-			if( *input == EOS ) {
-				fprintf( stderr, "No output format found.\n" );
+			if( output_mode_name[ i ] == NULL ) {
+				fprintf( stderr, "Line %d: Unrecognised output mode '%s'.\n", line, input );
 				return( FALSE );
 			}
-			if(( p = strchr( input, INSERT_HERE ))) {
-				*p++ = EOS;
-				output_format_a[ output_formats ] = DUP( input );
-				output_format_b[ output_formats ] = DUP( p );
-			}
-			else {
-				output_format_a[ output_formats ] = DUP( input );
-				output_format_b[ output_formats ] = "";
-			}
-			output_formats++;
+			output_mode = i;
+			output_mode_set = TRUE;
 			break;
 		}
-		case LANGUAGE_RECORD: {
-			char	*p, *q, *r;
-			
+		case OPTION_RECORD: {
+			char	*p;
+			int	i;
+
 			/*
-			 *	L language
+			 *	O option [value]	Adjust how the decoder is built
+			 *				and output.
 			 */
 			output_target = UNSPECIFIED_TARGET;
-			if(( output_comment_a != NULL )||( output_comment_b != NULL )) {
-				fprintf( stderr, "Output comment already specified.\n" );
-				return( FALSE );
-			}
-			/*
-			 *	Strip spaces...
-			 */
-			p = input;
-			while( *p != EOS ) {
-				if( isvisible( *p )) {
-					p++;
-				}
-				else {
-					/*
-					 *	Roll out the white space.
-					 */
-					q = p;
-					r = p+1;
-					while(( *q++ = *r++ ));
-				}
+			while(( *input )&&( !isvisible( *input ))) input++;
+			for( p = input; isvisible( *p ); p++ );
+			if( *p ) {
+				*p++ = EOS;
+				while(( *p )&&( !isvisible( *p ))) p++;
 			}
 			if( *input == EOS ) {
-				fprintf( stderr, "No language found.\n" );
+				fprintf( stderr, "Line %d: No option found.\n", line );
 				return( FALSE );
 			}
-			/*
-			 *	We have to remember to set up the output files, but only
-			 *	if the base name is non-NULL.
-			 */
-			if( strcasecmp( input, "c" ) == 0 ) {
-				/*
-				 *	C Language
-				 */
-				output_comment_a = "/*";
-				output_comment_b = "*/";
-				if( output_base_name ) {
-					output_header_name = strcatdup( output_base_name, ".h" );
-					output_source_name = strcatdup( output_base_name, ".c" );
-					if(( output_header = fopen( output_header_name, "w" )) == NULL ) {
-						fprintf( stderr, "Unable to open header file '%s'.\n", output_header_name );
-						return( FALSE );
-					}
-					if(( output_source = fopen( output_source_name, "w" )) == NULL ) {
-						fprintf( stderr, "Unable to open header file '%s'.\n", output_source_name );
+			for( i = 0; option_name[ i ]; i++ ) {
+				if( strcasecmp( input, option_name[ i ]) == 0 ) break;
+			}
+			switch( i ) {
+				case FIELD_OPTION: {
+					/*
+					 *	O FIELD n	Allow decision nodes to extract
+					 *			bit fields up to n bits wide.
+					 */
+					i = ( *p )? atoi( p ): MAX_FIELD;
+					if(( i <= 0 )||( i > MAX_FIELD )) {
+						fprintf( stderr, "Line %d: Invalid field width %d (maximum is %d).\n", line, i, MAX_FIELD );
 						return( FALSE );
 					}
+					field_bits = i;
+					break;
 				}
-			}
-			else {
-				if(( strcasecmp( input, "c++" ) == 0 )||( strcasecmp( input, "cpp" ) == 0 )) {
+				case LEVELS_OPTION: {
 					/*
-					 *	C++ Language
+					 *	O LEVELS BYTES		Pick the trie levels by
+					 *	O LEVELS LOADS		objective, or give the
+					 *	O LEVELS n n ...	widths explicitly.
 					 */
-					output_comment_a = "//";
-					output_comment_b = "";
-					if( output_base_name ) {
-						output_header_name = strcatdup( output_base_name, ".h" );
-						output_source_name = strcatdup( output_base_name, ".cpp" );
-						if(( output_header = fopen( output_header_name, "w" )) == NULL ) {
-							fprintf( stderr, "Unable to open header file '%s' for write.\n", output_header_name );
+					if( strncasecmp( p, "bytes", 5 ) == 0 ) {
+						trie_objective = 0;
+						break;
+					}
+					if( strncasecmp( p, "loads", 5 ) == 0 ) {
+						trie_objective = 1;
+						break;
+					}
+					trie_given = 0;
+					while( *p ) {
+						if( trie_given >= MAX_LEVELS ) {
+							fprintf( stderr, "Line %d: Too many trie levels (maximum is %d).\n", line, MAX_LEVELS );
 							return( FALSE );
 						}
-						if(( output_source = fopen( output_source_name, "w" )) == NULL ) {
-							fprintf( stderr, "Unable to open source file '%s' for write.\n", output_source_name );
+						i = (int)strtol( p, &p, 10 );
+						if(( i <= 0 )||( i > MAX_PAGE )) {
+							fprintf( stderr, "Line %d: Invalid trie level width %d (maximum is %d).\n", line, i, MAX_PAGE );
 							return( FALSE );
 						}
+						trie_width[ trie_given++ ] = i;
+						while(( *p )&&( !isvisible( *p ))) p++;
+					}
+					if( trie_given == 0 ) {
+						fprintf( stderr, "Line %d: No trie levels given.\n", line );
+						return( FALSE );
 					}
+					break;
 				}
-				else {
-					fprintf( stderr, "Unrecognised language '%s'.\n", input );
-					return( FALSE );
-				}	
-			}
-			break;
-		}
-		case TYPE_RECORD: {
-			char	*p, *q, *r;
-			
-			/*
-			 *	Strip spaces...
-			 */
-			output_target = UNSPECIFIED_TARGET;
-			p = input;
-			while( *p != EOS ) {
-				if( isvisible( *p )) {
-					p++;
+				case SHARE_OPTION: {
+					/*
+					 *	O SHARE		Output identical subtrees once.
+					 */
+					share_subtrees = TRUE;
+					break;
 				}
-				else {
+				case TRACE_OPTION: {
+					char	*q;
+
 					/*
-					 *	Roll out the white space.
+					 *	O TRACE file	Count the opcodes in a trace
+					 *			file as instruction weights.
 					 */
-					q = p;
-					r = p+1;
-					while(( *q++ = *r++ ));
+					for( q = p + strlen( p ); ( q > p )&&( !isvisible( q[ -1 ])); *--q = EOS );
+					if( *p == EOS ) {
+						fprintf( stderr, "Line %d: No trace file given.\n", line );
+						return( FALSE );
+					}
+					if( trace_file ) {
+						fprintf( stderr, "Line %d: Trace file already set.\n", line );
+						return( FALSE );
+					}
+					trace_file = intern( p );
+					break;
 				}
-			}
-			if( *input == EOS ) {
-				fprintf( stderr, "No data type found.\n" );
-				return( FALSE );
-			}
-			if( data_type ) {
-				fprintf( stderr, "Data type already set.\n" );
-			}
-			data_type = DUP( input );
-			break;
-		}
-		case SCOPE_RECORD: {
-			char	*p, *q, *r;
-			
-			/*
-			 *	Strip spaces...
-			 */
-			output_target = UNSPECIFIED_TARGET;
-			p = input;
-			while( *p != EOS ) {
-				if( isvisible( *p )) {
-					p++;
+				case STRATEGY_OPTION: {
+					/*
+					 *	O STRATEGY name	How to choose split bits.
+					 */
+					for( i = 0; strategy_name[ i ]; i++ ) {
+						if( strncasecmp( p, strategy_name[ i ], strlen( strategy_name[ i ])) == 0 ) break;
+					}
+					if( strategy_name[ i ] == NULL ) {
+						fprintf( stderr, "Line %d: Unrecognised strategy '%s'.\n", line, p );
+						return( FALSE );
+					}
+					split_strategy = i;
+					strategy_set = TRUE;
+					break;
 				}
-				else {
+				case OBJECTIVE_OPTION: {
 					/*
-					 *	Roll out the white space.
+					 *	O OBJECTIVE name	What the best tree is.
 					 */
-					q = p;
-					r = p+1;
-					while(( *q++ = *r++ ));
+					for( i = 0; objective_name[ i ]; i++ ) {
+						if( strncasecmp( p, objective_name[ i ], strlen( objective_name[ i ])) == 0 ) break;
+					}
+					if( objective_name[ i ] == NULL ) {
+						fprintf( stderr, "Line %d: Unrecognised objective '%s'.\n", line, p );
+						return( FALSE );
+					}
+					split_objective = i;
+					break;
 				}
-			}
-			if( *input == EOS ) {
-				fprintf( stderr, "No scope found.\n" );
-				return( FALSE );
-			}
-			if( data_scope ) {
-				fprintf( stderr, "Scope already set.\n" );
-			}
-			data_scope = DUP( input );
+				case CONSTEXPR_OPTION: {
+					/*
+					 *	O CONSTEXPR	Output constexpr arrays
+					 *			and find routine.
+					 */
+					constexpr_output = TRUE;
+					break;
+				}
+				case PACKED_OPTION: {
+					/*
+					 *	O PACKED [bits]	Pack the table rows into
+					 *			16 or 32 bit entries.
+					 */
+					i = ( *p )? atoi( p ): 0;
+					if(( i != 0 )&&( i != 16 )&&( i != 32 )) {
+						fprintf( stderr, "Line %d: Invalid packed entry size %d (16 or 32).\n", line, i );
+						return( FALSE );
+					}
+					packed_output = TRUE;
+					packed_bits = i;
+					break;
+				}
+				case VALUE_OPTION: {
+					char	*q;
+
+					/*
+					 *	O VALUE type	Give the type of the next
+					 *			value array.
+					 */
+					for( q = p + strlen( p ); ( q > p )&&( !isvisible( q[ -1 ])); *--q = EOS );
+					if( *p == EOS ) {
+						fprintf( stderr, "Line %d: No value type given.\n", line );
+						return( FALSE );
+					}
+					if( value_types >= MAX_FORMATS ) {
+						fprintf( stderr, "Line %d: Too many value types specified (maximum is %d).\n", line, MAX_FORMATS );
+						return( FALSE );
+					}
+					value_type[ value_types++ ] = intern_name( p );
+					break;
+				}
+				case LAYOUT_OPTION: {
+					/*
+					 *	O LAYOUT name	Order of the table rows.
+					 */
+					for( i = 0; layout_name[ i ]; i++ ) {
+						if( strncasecmp( p, layout_name[ i ], strlen( layout_name[ i ])) == 0 ) break;
+					}
+					if( layout_name[ i ] == NULL ) {
+						fprintf( stderr, "Line %d: Unrecognised layout '%s'.\n", line, p );
+						return( FALSE );
+					}
+					table_layout = i;
+					layout_set = TRUE;
+					break;
+				}
+				case INVERT_OPTION: {
+					/*
+					 *	O INVERT	Choose which branch of each
+					 *			one bit node follows it.
+					 */
+					invert_tests = TRUE;
+					layout_set = TRUE;
+					break;
+				}
+				case ALIGN_OPTION: {
+					/*
+					 *	O ALIGN		Align the table to a line.
+					 */
+					align_table = TRUE;
+					break;
+				}
+				case CACHE_OPTION: {
+					/*
+					 *	O CACHE line [row]	Cache line and row
+					 *				sizes in bytes.
+					 */
+					cache_line = (int)strtol( p, &p, 10 );
+					while(( *p )&&( !isvisible( *p ))) p++;
+					if( *p ) row_bytes = atoi( p );
+					if(( cache_line <= 0 )||( cache_line & ( cache_line - 1 ))||( row_bytes <= 0 )) {
+						fprintf( stderr, "Line %d: Invalid cache line (a power of 2) or row size.\n", line );
+						return( FALSE );
+					}
+					layout_set = TRUE;
+					break;
+				}
+				case UNROLL_OPTION: {
+					/*
+					 *	O UNROLL	Unroll the table walk.
+					 */
+					unroll_walk = TRUE;
+					break;
+				}
+				case BATCH_OPTION: {
+					/*
+					 *	O BATCH		Output the batch routine.
+					 */
+					batch_output = TRUE;
+					break;
+				}
+				case PREDECODE_OPTION: {
+					/*
+					 *	O PREDECODE	Output the predecode cache.
+					 */
+					predecode_cache = TRUE;
+					break;
+				}
+				case OPERANDS_OPTION: {
+					/*
+					 *	O OPERANDS	Output operand extractors.
+					 */
+					operand_output = TRUE;
+					break;
+				}
+				case DISPATCH_OPTION: {
+					/*
+					 *	O DISPATCH [name]	Output a dispatch
+					 *				skeleton, GOTO or
+					 *				TAIL.
+					 */
+					if( *p == EOS ) {
+						dispatch_form = GOTO_DISPATCH;
+						break;
+					}
+					for( i = GOTO_DISPATCH; dispatch_name[ i ]; i++ ) {
+						if( strncasecmp( p, dispatch_name[ i ], strlen( dispatch_name[ i ])) == 0 ) break;
+					}
+					if( dispatch_name[ i ] == NULL ) {
+						fprintf( stderr, "Line %d: Unrecognised dispatch '%s'.\n", line, p );
+						return( FALSE );
+					}
+					dispatch_form = i;
+					break;
+				}
+				case FETCH_OPTION: {
+					/*
+					 *	O FETCH		Fetch words lazily.
+					 */
+					lazy_fetch = TRUE;
+					break;
+				}
+				case BENCHMARK_OPTION: {
+					/*
+					 *	O BENCHMARK	Output the benchmark.
+					 */
+					benchmark_output = TRUE;
+					break;
+				}
+				default: {
+					fprintf( stderr, "Line %d: Unrecognised option '%s'.\n", line, input );
+					return( FALSE );
+				}
+			}
 			break;
 		}
-		case NAME_RECORD: {
-			char	*p, *q, *r;
+		case FORMAT_RECORD: {
+			char	*p;
 			
+			/*
+			 *	F ffff[%ffff]
+			 */
+			output_target = UNSPECIFIED_TARGET;
+			if( output_formats >= MAX_FORMATS ) {
+				fprintf( stderr, "Line %d: Too many output formats specified (maximum is %d).\n", line, MAX_FORMATS );
+				return( FALSE );
+			}
 			/*
 			 *	Strip spaces...
 			 */
+			strip_spaces( input );
+			if( *input == EOS ) {
+				fprintf( stderr, "No output format found.\n" );
+				return( FALSE );
+			}
+			if(( p = strchr( input, INSERT_HERE ))) {
+				*p++ = EOS;
+				output_format_a[ output_formats ] = intern( input );
+				output_format_b[ output_formats ] = intern( p );
+			}
+			else {
+				output_format_a[ output_formats ] = intern( input );
+				output_format_b[ output_formats ] = "";
+			}
+			output_formats++;
+			break;
+		}
+		case LANGUAGE_RECORD: {
+			/*
+			 *	L language
+			 */
 			output_target = UNSPECIFIED_TARGET;
-			p = input;
-			while( *p != EOS ) {
-				if( isvisible( *p )) {
-					p++;
+			if(( output_comment_a != NULL )||( output_comment_b != NULL )) {
+				fprintf( stderr, "Output comment already specified.\n" );
+				return( FALSE );
+			}
+			/*
+			 *	Strip spaces...
+			 */
+			strip_spaces( input );
+			if( *input == EOS ) {
+				fprintf( stderr, "No language found.\n" );
+				return( FALSE );
+			}
+			/*
+			 *	We have to remember to set up the output files, but only
+			 *	if the base name is non-NULL.
+			 */
+			if( strcasecmp( input, "c" ) == 0 ) {
+				/*
+				 *	C Language
+				 */
+				output_comment_a = "/*";
+				output_comment_b = "*/";
+				if( output_base_name ) {
+					output_header_name = strcatdup( output_base_name, ".h" );
+					output_source_name = strcatdup( output_base_name, ".c" );
+					if(( output_header = open_output( output_header_name, &output_header_temp )) == NULL ) {
+						fprintf( stderr, "Unable to open header file '%s'.\n", output_header_name );
+						return( FALSE );
+					}
+					if(( output_source = open_output( output_source_name, &output_source_temp )) == NULL ) {
+						fprintf( stderr, "Unable to open header file '%s'.\n", output_source_name );
+						return( FALSE );
+					}
 				}
-				else {
+			}
+			else {
+				if(( strcasecmp( input, "c++" ) == 0 )||( strcasecmp( input, "cpp" ) == 0 )) {
 					/*
-					 *	Roll out the white space.
+					 *	C++ Language
 					 */
-					q = p;
-					r = p+1;
-					while(( *q++ = *r++ ));
+					output_comment_a = "//";
+					output_comment_b = "";
+					output_cpp = TRUE;
+					if( output_base_name ) {
+						output_header_name = strcatdup( output_base_name, ".h" );
+						output_source_name = strcatdup( output_base_name, ".cpp" );
+						if(( output_header = open_output( output_header_name, &output_header_temp )) == NULL ) {
+							fprintf( stderr, "Unable to open header file '%s' for write.\n", output_header_name );
+							return( FALSE );
+						}
+						if(( output_source = open_output( output_source_name, &output_source_temp )) == NULL ) {
+							fprintf( stderr, "Unable to open source file '%s' for write.\n", output_source_name );
+							return( FALSE );
+						}
+					}
 				}
+				else {
+					fprintf( stderr, "Unrecognised language '%s'.\n", input );
+					return( FALSE );
+				}	
+			}
+			break;
+		}
+		case TYPE_RECORD: {
+			/*
+			 *	Strip spaces...
+			 */
+			output_target = UNSPECIFIED_TARGET;
+			strip_spaces( input );
+			if( *input == EOS ) {
+				fprintf( stderr, "No data type found.\n" );
+				return( FALSE );
+			}
+			if( data_type ) {
+				fprintf( stderr, "Data type already set.\n" );
+			}
+			data_type = intern_name( input );
+			break;
+		}
+		case SCOPE_RECORD: {
+			/*
+			 *	Strip spaces...
+			 */
+			output_target = UNSPECIFIED_TARGET;
+			strip_spaces( input );
+			if( *input == EOS ) {
+				fprintf( stderr, "No scope found.\n" );
+				return( FALSE );
+			}
+			if( data_scope ) {
+				fprintf( stderr, "Scope already set.\n" );
 			}
+			data_scope = intern_name( input );
+			break;
+		}
+		case NAME_RECORD: {
+			/*
+			 *	Strip spaces...
+			 */
+			output_target = UNSPECIFIED_TARGET;
+			strip_spaces( input );
 			if( *input == EOS ) {
 				fprintf( stderr, "No data name found.\n" );
 				return( FALSE );
@@ -741,30 +2085,44 @@ static bool process( int line, char *input, char *comment ) {
 			if( data_name ) {
 				fprintf( stderr, "Data name already set.\n" );
 			}
-			data_name = DUP( input );
+			data_name = intern_name( input );
+			break;
+		}
+		case RATE_RECORD: {
+			RATE	*r;
+			char	*p;
+
+			/*
+			 *	R name weight
+			 */
+			output_target = UNSPECIFIED_TARGET;
+			while(( *input )&&( !isvisible( *input ))) input++;
+			for( p = input; isvisible( *p ); p++ );
+			if( *p ) *p++ = EOS;
+			if( *input == EOS ) {
+				fprintf( stderr, "Line %d: No instruction name given.\n", line );
+				return( FALSE );
+			}
+			r = (RATE *)arena_alloc( &record_arena, sizeof( RATE ), ARENA_ALIGN );
+			r->line = line;
+			r->name = intern( input );
+			r->weight = strtoul( p, &p, 10 );
+			while(( *p )&&( !isvisible( *p ))) p++;
+			if( *p ) {
+				fprintf( stderr, "Line %d: Invalid weight '%s'.\n", line, p );
+				return( FALSE );
+			}
+			r->next = NULL;
+			*rate_tail = r;
+			rate_tail = &( r->next );
 			break;
 		}
 		case ERROR_RECORD: {
-			char	*p, *q, *r;
-			
 			/*
 			 *	Strip spaces...
 			 */
 			output_target = UNSPECIFIED_TARGET;
-			p = input;
-			while( *p != EOS ) {
-				if( isvisible( *p )) {
-					p++;
-				}
-				else {
-					/*
-					 *	Roll out the white space.
-					 */
-					q = p;
-					r = p+1;
-					while(( *q++ = *r++ ));
-				}
-			}
+			strip_spaces( input );
 			if( *input == EOS ) {
 				fprintf( stderr, "No error handler found.\n" );
 				return( FALSE );
@@ -772,7 +2130,7 @@ static bool process( int line, char *input, char *comment ) {
 			if( error_handler ) {
 				fprintf( stderr, "Error handler already set.\n" );
 			}
-			error_handler = DUP( input );
+			error_handler = intern_name( input );
 			break;
 		}
 		case SPACE:
@@ -805,9 +2163,10 @@ static bool process( int line, char *input, char *comment ) {
 			 *	Add more data to the end of the file.
 			 */
 			output_target = UNSPECIFIED_TARGET;
-			FINISH *ptr = NEW( FINISH );
+			FINISH *ptr = (FINISH *)arena_alloc( &record_arena, sizeof( FINISH ), ARENA_ALIGN );
 			ptr->line = line;
-			ptr->data = DUP( input );
+			ptr->data = intern( input );
+			ptr->length = strlen( input );
 			ptr->next = NULL;
 			*finish_data_tail = ptr;
 			finish_data_tail = &( ptr->next );
@@ -826,28 +2185,20 @@ static bool process( int line, char *input, char *comment ) {
 		}
 		case INSTRUCTION_RECORD: {
 			INSTRUCTION	*p;
+			word		opcode[ MAX_CODES ],
+					mask[ MAX_CODES ];
+			char		*description[ MAX_CODES ],
+					*name;
+			int		elements,
+					n;
 
-			/*
-			 *	Start with new empty record, and link it in.
-			 */
-			output_target = UNSPECIFIED_TARGET;
-			p = NEW( INSTRUCTION );
-			p->line = line;
-			p->name = NULL;
-			p->comment = DUP( comment );
-			p->elements = 0;
-			for( int i = 0; i < MAX_CODES; p->opcode[ i++ ] = 0 );
-			for( int i = 0; i < MAX_CODES; p->mask[ i++ ] = 0 );
-			for( int i = 0; i < MAX_CODES; p->description[ i++ ] = NULL );
-			for( int i = 0; i < MAX_CODES; p->unmatched[ i++ ] = 0 );
-			p->matches = 0;
-			p->next = NULL;
-			*instruction_tail = p;
-			instruction_tail = &( p->next );
 			/*
 			 *	Fill in the record; start by breaking the input up into
 			 *	space separated units (but still ignoring initial spaces).
 			 */
+			output_target = UNSPECIFIED_TARGET;
+			name = NULL;
+			elements = 0;
 			while(( *input )&&( !isvisible( *input ))) input += 1;
 			while( *input ) {
 				char	*e;
@@ -886,34 +2237,36 @@ static bool process( int line, char *input, char *comment ) {
 					/*
 					 *	Can we add this to the instruction record?
 					 */
-					if( p->elements >= MAX_CODES ) {
+					if( elements >= MAX_CODES ) {
 						fprintf( stderr, "Found instruction too big (maximum %d words).\n", MAX_CODES );
 						return( FALSE );
 					}
 					/*
 					 *	Fill in instruction data.
 					 */
-					i = p->elements++;
+					i = elements++;
+					opcode[ i ] = 0;
+					mask[ i ] = 0;
 					for( char *l = input; *l; l++ ) {
 						switch( *l ) {
 							case ONE_BIT: {
-								p->opcode[ i ] = ( p->opcode[ i ] << 1 ) | 1;
-								p->mask[ i ] = ( p->mask[ i ] << 1 ) | 1;
+								opcode[ i ] = ( opcode[ i ] << 1 ) | 1;
+								mask[ i ] = ( mask[ i ] << 1 ) | 1;
 								break;
 							}
 							case ZERO_BIT: {
-								p->opcode[ i ] = ( p->opcode[ i ] << 1 ) | 0;
-								p->mask[ i ] = ( p->mask[ i ] << 1 ) | 1;
+								opcode[ i ] = ( opcode[ i ] << 1 ) | 0;
+								mask[ i ] = ( mask[ i ] << 1 ) | 1;
 								break;
 							}
 							default: {
-								p->opcode[ i ] = ( p->opcode[ i ] << 1 ) | 0;
-								p->mask[ i ] = ( p->mask[ i ] << 1 ) | 0;
+								opcode[ i ] = ( opcode[ i ] << 1 ) | 0;
+								mask[ i ] = ( mask[ i ] << 1 ) | 0;
 								break;
 							}
 						}
 					}
-					p->description[ i ] = DUP( input );
+					description[ i ] = intern( input );
 				}
 				else {
 					/*
@@ -929,13 +2282,39 @@ static bool process( int line, char *input, char *comment ) {
 					 *
 					 *	.. eventually.
 					 */
-					p->name = DUP( input );
+					name = intern_name( input );
 				}
 				/*
 				 *	Move input to, the start of the next text of interest.
 				 */
 				input = e;
 			}
+			/*
+			 *	Now the size is known, take the record (with room
+			 *	for exactly its words, but at least one) from the
+			 *	record arena and link it in.
+			 */
+			n = ( elements )? elements: 1;
+			p = (INSTRUCTION *)arena_alloc( &record_arena, sizeof( INSTRUCTION ) + n * ( sizeof( char * ) + 3 * sizeof( word )), ARENA_ALIGN );
+			p->description = (char **)( p + 1 );
+			p->opcode = (word *)( p->description + n );
+			p->mask = p->opcode + n;
+			p->unmatched = p->mask + n;
+			p->line = line;
+			p->name = name;
+			p->comment = intern( comment );
+			p->elements = elements;
+			for( int i = 0; i < n; i++ ) {
+				p->opcode[ i ] = ( i < elements )? opcode[ i ]: 0;
+				p->mask[ i ] = ( i < elements )? mask[ i ]: 0;
+				p->description[ i ] = ( i < elements )? description[ i ]: NULL;
+				p->unmatched[ i ] = 0;
+			}
+			p->matches = 0;
+			p->weight = 0;
+			p->next = NULL;
+			*instruction_tail = p;
+			instruction_tail = &( p->next );
 			break;
 		}
 		default: {
@@ -953,419 +2332,4598 @@ static bool process( int line, char *input, char *comment ) {
 }
 
 /*
- *	Recursive tree building routine.
- *
- *	Create tree using a binary division mechanism
+ *	Create a tree node.  With bits zero this is a leaf node for
+ *	the decoded instruction (NULL being an error leaf), otherwise
+ *	it is a decision node testing bits bits of opcode word w from
+ *	bit b upwards.
  */
-static NODE *insert( word *mask, INSTRUCTION *list, int count ) {
-	int		w,
-			b,
-			d;
-	bool		v;
-	word		t;
-	NODE		*here;
-	INSTRUCTION	*ptr,
-			*ones,
-			*zeros;
-	int		c0,
-			c1;
+static NODE *new_node( INSTRUCTION *decoded, int w, int b, int bits ) {
+	NODE	*here;
 
-	/*
-	 *	Deal with up front cases first.
-	 */
-	if( count == 0 ) {
-		/* Error Leaf node time! */
-		here = NEW( NODE );
-		here->index = 0;
-		here->leaf = TRUE;
-		here->decoded = NULL;
-		here->op_word = 0;
-		here->op_bit = 0;
-		here->zero = NULL;
-		here->one = NULL;
-		return( here );
+	if(( here = node_spare[ bits ])) {
+		node_spare[ bits ] = here->child[ 0 ];
 	}
-	if( count == 1 ) {
-		/*
-		 *	Brief duplication check:  Getting here should mean that
-		 *	the AND result of the mask value passed in and the mask
-		 * 	value of the instruction results in 0.  If there are n
-		 * 	bits still set then that instruction is accessible through
-		 * 	2^n alternative opcodes.
-		 */
-		count = 0;
-		for( int i = 0; i < MAX_CODES; i++ ) {
-			list->unmatched[ i ] = t = mask[ i ] & list->mask[ i ];
-			for( int j = 0; j < word_size; j++ ) {
-				if( t & 1 ) count++;
-				t >>= 1;
-			}
-		}
-		/*
-		 *	How are we handling error/illegal instructions?
-		 */
-		if( count && error_handler ) {
-			/*
-			 *	Error handler defined, so we have to (carefully)
-			 *	force the system to carry on building the
-			 *	decision tree.
-			 *
-			 *	All we need to do here is find the first ambiguous
-			 *	opcode bit, decide which side this instruction goes,
-			 *	for a decision node and repeat recursive call.
-			 *
-			 *	We know that at least one of the unmatched[] elements
-			 *	is non-zero.  That is our target opcode word.
-			 */
-			for( int i = 0; i < MAX_CODES; i++ ) {
-				if( list->unmatched[ i ]) {
-					/*
-					 *	Word i is where we make the decision.
-					 *
-					 *	step j through bits from msb to lsb.
-					 */
-					int j = word_size;
-					while( j-- ) {
-						word t = 1 << j;
-						if( list->unmatched[ i ] & t ) {
-							/*
-							 *	Ambiguous bit found, create new node.
-							 */
-							here = NEW( NODE );
-							here->index = 0;
-							here->leaf = FALSE;
-							here->decoded = NULL;
-							here->op_word = i;
-							here->op_bit = j;
-							mask[ i ] &= ~t;
-							if( list->opcode[ i ] & t ) {
-								/* Pick the ONE side. */
-								here->zero = insert( mask, NULL, 0 );
-								here->one = insert( mask, list, 1 );
+	else {
+		here = (NODE *)arena_alloc( &node_arena, sizeof( NODE ) + ( sizeof( NODE * ) << bits ), ARENA_ALIGN );
+	}
+	here->index = 0;
+	here->base = 0;
+	here->invert = FALSE;
+	here->leaf = ( bits == 0 );
+	here->decoded = decoded;
+	here->op_word = w;
+	here->op_bit = b;
+	here->op_bits = bits;
+	if( bits ) {
+		here->child = (NODE **)( here + 1 );
+		for( int i = 0; i < ( 1 << bits ); here->child[ i++ ] = NULL );
+	}
+	else {
+		here->child = NULL;
+	}
+	return( here );
+}
+
+/*
+ *	Give back a (decision) node no longer wanted, for reuse by the
+ *	next node of its size.
+ */
+static void free_node( NODE *here ) {
+	here->child[ 0 ] = node_spare[ here->op_bits ];
+	node_spare[ here->op_bits ] = here;
+}
+
+/*
+ *	Return the mask covering a field of n bits from bit b upwards.
+ */
+static word field_mask( int b, int n ) {
+	return((( n < WORD_BITS )? (((word)1) << n ) - 1: ~((word)0 )) << b );
+}
+
+/*
+ *	Return the number of bits set in a word.
+ */
+static int bit_count( word w ) {
+	int	n = 0;
+
+	while( w ) {
+		n += w & 1;
+		w >>= 1;
+	}
+	return( n );
+}
+
+/*
+ *	Return the number of single bit tests needed to separate a
+ *	number of instructions in a balanced tree.
+ */
+static unsigned long bits_needed( int count ) {
+	unsigned long	n = 0;
+
+	while(( 1 << n ) < count ) n++;
+	return( n );
+}
+
+/*
+ *	Transpose a block of 64 words, zero extended, so that the bits
+ *	of word 63-p become bit p of each entry, entry 63-b holding the
+ *	bits b of them all (a 64 by 64 bit matrix transpose done a
+ *	half, a quarter and so on at a time).
+ */
+static void transpose_block( uint64_t *a ) {
+	uint64_t	m = 0x00000000FFFFFFFFULL,
+			t;
+
+	for( int j = 32; j; j >>= 1, m ^= m << j ) {
+		for( int k = 0; k < 64; k = ( k + j + 1 ) & ~j ) {
+			t = ( a[ k ] ^ ( a[ k + j ] >> j )) & m;
+			a[ k ] ^= t;
+			a[ k + j ] ^= t << j;
+		}
+	}
+}
+
+/*
+ *	Count, for each bit of word i still to be tested, the records
+ *	of a list having it as a zero (c0) and as a one (c1).  The
+ *	list is taken 64 records at a time as bit slices, the defined
+ *	bits and the one bits of each being transposed into a 64 bit
+ *	column per bit, so each count is a population count.
+ */
+static void slice_counts( word *mask, INSTRUCTION *list, int i, int *c0, int *c1 ) {
+	uint64_t	fixed[ 64 ],
+			value[ 64 ];
+	INSTRUCTION	*ptr = list;
+
+	for( int j = 0; j < word_size; j++ ) c0[ j ] = c1[ j ] = 0;
+	while( ptr ) {
+		int	n;
+
+		for( n = 0; ( n < 64 )&& ptr; n++, ptr = ptr->next ) {
+			fixed[ n ] = mask[ i ] & MASK( ptr, i );
+			value[ n ] = fixed[ n ] & OPCODE( ptr, i );
+		}
+		for( ; n < 64; n++ ) fixed[ n ] = value[ n ] = 0;
+		transpose_block( fixed );
+		transpose_block( value );
+		for( int j = 0; j < word_size; j++ ) {
+			int	ones = __builtin_popcountll( value[ 63 - j ]);
+
+			c1[ j ] += ones;
+			c0[ j ] += __builtin_popcountll( fixed[ 63 - j ]) - ones;
+		}
+	}
+}
+
+/*
+ *	Choose the split bit by balance.
+ *
+ * 	d	the difference between the number of 0 bit
+ * 		records and 1 bit records.
+ *
+ *	e	the estimated weighted depth below the split;
+ *		the weight of each side times the tests needed
+ *		to separate its records (always zero when no
+ *		weights have been given).  This is minimised
+ *		first, so frequent instructions end up on the
+ *		side with fewer records, nearer the top of
+ *		the tree.
+ */
+static bool balance_split( word *mask, INSTRUCTION *list, int count, int *w, int *b ) {
+	bool		v;
+	int		c0[ WORD_BITS ],
+			c1[ WORD_BITS ],
+			d;
+	unsigned long	e,
+			w0[ WORD_BITS ],
+			w1[ WORD_BITS ];
+
+	v = FALSE;
+	d = 0;
+	e = 0;
+	for( int i = 0; i < split_words; i++ ) {
+		int j;
+
+		if( count >= MIN_SLICE ) {
+			slice_counts( mask, list, i, c0, c1 );
+		}
+		else {
+			for( j = 0; j < word_size; j++ ) {
+				word k = (word)1 << j;
+
+				c1[ j ] = 0;
+				c0[ j ] = 0;
+				if( mask[ i ] & k ) {
+					for( INSTRUCTION *l = list; l; l = l->next ) {
+						if( MASK( l, i ) & k ) {
+							if( l->opcode[ i ] & k ) {
+								c1[ j ]++;
 							}
 							else {
-								 /* Pick the ZERO size. */
-								here->zero = insert( mask, list, 1 );
-								here->one = insert( mask, NULL, 0 );
+								c0[ j ]++;
 							}
-							mask[ i ] |= t;
-							return( here );
 						}
 					}
 				}
 			}
-			/*
-			 *	If we fall out here then this IS a programming error.
-			 */
-			fprintf( stderr, "Coding error '%s' line %d.\n", __FILE__, __LINE__ );
-			exit( -1 );
 		}
 		/*
-		 *	No Error handler has been defined, so output this node
-		 *	with the duplication information attached to it.
+		 *	The weight of each side of the bits every record
+		 *	defines.
 		 */
-		list->matches = 1 << count;
-		/* Leaf node time! */
-		here = NEW( NODE );
-		here->index = 0;
-		here->leaf = TRUE;
-		here->decoded = list;
-		here->op_word = 0;
-		here->op_bit = 0;
-		here->zero = NULL;
-		here->one = NULL;
-		return( here );
+		for( j = 0; j < word_size; j++ ) {
+			word k = (word)1 << j;
+
+			w1[ j ] = 0;
+			w0[ j ] = 0;
+			if( weighted &&(( c1[ j ] + c0[ j ]) == count )) {
+				for( INSTRUCTION *l = list; l; l = l->next ) {
+					if( l->opcode[ i ] & k ) {
+						w1[ j ] += l->weight;
+					}
+					else {
+						w0[ j ] += l->weight;
+					}
+				}
+			}
+		}
+		j = word_size;
+		while( j-- ) {
+			if(( c1[ j ] + c0[ j ]) == count ) {
+				int x = (( c1[ j ] < c0[ j ])?( c0[ j ] - c1[ j ]):( c1[ j ] - c0[ j ]));
+				unsigned long y = w0[ j ] * bits_needed( c0[ j ]) + w1[ j ] * bits_needed( c1[ j ]);
+				if( v ) {
+					if(( y < e )||(( y == e )&&( x < d ))) {
+						d = x;
+						e = y;
+						*w = i;
+						*b = j;
+					}
+				}
+				else {
+					v = TRUE;
+					d = x;
+					e = y;
+					*w = i;
+					*b = j;
+				}
+			}
+		}
 	}
-	/*
-	 *	The list is multiple options, so...
-	 * 
-	 *	Find the word and bit which we will be using to
-	 *	split the list into two parts.
-	 *
-	 * 	w	The opcode number (0 .. MAX_CODES-1)
-	 *
-	 * 	b	The bit number (word_size-1 .. 0)
-	 *
-	 * 	d	the difference between the number of 0 bit
-	 * 		records and 1 bit records.
-	 *
-	 * 	v	true if a valid differentiation has been
-	 * 		located.
+	return( v );
+}
+
+/*
+ *	Return the share of the decoding an instruction accounts for;
+ *	its weight if there are weights, otherwise the fraction of the
+ *	possible first words which decode to it.
+ */
+static double opcode_share( INSTRUCTION *ptr ) {
+	double	share = 1.0;
+
+	if( weighted ) return((double)ptr->weight );
+	for( int i = bit_count( ptr->mask[ 0 ]); i < word_size; i++ ) share *= 2.0;
+	return( share );
+}
+
+/*
+ *	Choose the split bit by entropy.
+ *
+ *	Each record has its share of the decoding (see above).  The
+ *	information gained by a split is the entropy of the division
+ *	of those shares between its two sides, since each record is
+ *	distinct, so the best split is the one dividing the shares
+ *	most evenly.  Ties go to the most even count of records.
+ */
+static bool entropy_split( word *mask, INSTRUCTION *list, int count, int *w, int *b ) {
+	bool	v;
+	int	c0,
+		c1,
+		d;
+	double	e;
+
+	v = FALSE;
+	d = 0;
+	e = 0.0;
+	for( int i = 0; i < MAX_CODES; i++ ) {
+		int j = word_size;
+		while( j-- ) {
+			word	k = ((word)1 ) << j;
+			double	p0, p1;
+
+			c1 = 0;
+			c0 = 0;
+			p1 = 0.0;
+			p0 = 0.0;
+			if( mask[ i ] & k ) {
+				for( INSTRUCTION *l = list; l; l = l->next ) {
+					if( MASK( l, i ) & k ) {
+						if( l->opcode[ i ] & k ) {
+							c1++;
+							p1 += opcode_share( l );
+						}
+						else {
+							c0++;
+							p0 += opcode_share( l );
+						}
+					}
+				}
+			}
+			if(( c1 + c0 ) == count ) {
+				int	x = (( c1 < c0 )?( c0 - c1 ):( c1 - c0 ));
+				double	y = (( p1 < p0 )?( p0 - p1 ):( p1 - p0 ));
+
+				if( !v ||( y < e )||(( y == e )&&( x < d ))) {
+					v = TRUE;
+					d = x;
+					e = y;
+					*w = i;
+					*b = j;
+				}
+			}
+		}
+	}
+	return( v );
+}
+
+/*
+ *	Return the weight of an instruction when measuring walks; every
+ *	instruction counts the same without weights.
+ */
+static double walk_weight( INSTRUCTION *ptr ) {
+	return(( weighted )? (double)ptr->weight: 1.0 );
+}
+
+/*
+ *	Return the number of untested bits an instruction defines.
+ */
+static int untested_bits( INSTRUCTION *ptr, word *mask ) {
+	int	n = 0;
+
+	for( int i = 0; i < ptr->elements; i++ ) n += bit_count( ptr->mask[ i ] & mask[ i ]);
+	return( n );
+}
+
+/*
+ *	Work out the cost of a leaf for an instruction.  With an error
+ *	handler every untested bit it defines still has to be checked,
+ *	each adding a decision row and an error leaf row.
+ */
+static void leaf_cost( INSTRUCTION *ptr, word *mask, COST *cost ) {
+	int	n = ( error_handler )? untested_bits( ptr, mask ): 0;
+
+	cost->rows = 1 + 2 * n;
+	cost->most = 1 + n;
+	cost->weight = walk_weight( ptr );
+	cost->sum = cost->weight * ( 1 + n );
+}
+
+/*
+ *	Work out the cost of a decision node over two subtrees.
+ */
+static void join_cost( COST *zero, COST *one, COST *cost ) {
+	cost->rows = 1 + zero->rows + one->rows;
+	cost->most = 1 + (( zero->most > one->most )? zero->most: one->most );
+	cost->weight = zero->weight + one->weight;
+	cost->sum = zero->sum + one->sum + cost->weight;
+}
+
+/*
+ *	Is cost a better than cost b by the objective selected?  The
+ *	other measures break ties.
+ */
+static bool cheaper( COST *a, COST *b ) {
+	switch( split_objective ) {
+		case ROWS_OBJECTIVE: {
+			if( a->rows != b->rows ) return( a->rows < b->rows );
+			if( a->sum != b->sum ) return( a->sum < b->sum );
+			return( a->most < b->most );
+		}
+		case MAXIMUM_OBJECTIVE: {
+			if( a->most != b->most ) return( a->most < b->most );
+			if( a->sum != b->sum ) return( a->sum < b->sum );
+			return( a->rows < b->rows );
+		}
+		default: {
+			if( a->sum != b->sum ) return( a->sum < b->sum );
+			if( a->most != b->most ) return( a->most < b->most );
+			return( a->rows < b->rows );
+		}
+	}
+}
+
+/*
+ *	Estimate the cost of separating a set of instructions without
+ *	looking any further, assuming a balanced tree.
+ */
+static void estimate_cost( INSTRUCTION **set, int n, word *mask, COST *cost ) {
+	int	depth = bits_needed( n );
+
+	cost->rows = 2 * n - 1;
+	cost->most = 0;
+	cost->weight = 0.0;
+	cost->sum = 0.0;
+	for( int i = 0; i < n; i++ ) {
+		int	left = ( error_handler )? untested_bits( set[ i ], mask ) - depth: 0,
+			walk;
+
+		if( left < 0 ) left = 0;
+		walk = depth + 1 + left;
+		cost->rows += 2 * left;
+		if( walk > cost->most ) cost->most = walk;
+		cost->weight += walk_weight( set[ i ]);
+		cost->sum += walk_weight( set[ i ]) * walk;
+	}
+}
+
+/*
+ *	Divide a set of instructions by bit k of word w, returning how
+ *	many have the bit clear (or -1 if any does not define it).
+ */
+static int divide_set( INSTRUCTION **set, int n, int w, word k, INSTRUCTION **zeros, INSTRUCTION **ones ) {
+	int	c0 = 0,
+		c1 = 0;
+
+	for( int i = 0; i < n; i++ ) {
+		if(( MASK( set[ i ], w ) & k ) == 0 ) return( -1 );
+		if( set[ i ]->opcode[ w ] & k ) {
+			ones[ c1++ ] = set[ i ];
+		}
+		else {
+			zeros[ c0++ ] = set[ i ];
+		}
+	}
+	return( c0 );
+}
+
+/*
+ *	Find the best split of a set of instructions by trying every
+ *	split (and the best splits below those) to the given depth, then
+ *	estimating the rest.  Returns FALSE when no bit divides the set.
+ */
+static bool look_ahead( INSTRUCTION **set, int n, word *mask, int depth, COST *best, int *w, int *b ) {
+	INSTRUCTION	**zeros,
+			**ones;
+	bool		found = FALSE;
+
+	if( n == 1 ) {
+		leaf_cost( set[ 0 ], mask, best );
+		return( TRUE );
+	}
+	if( depth == 0 ) {
+		estimate_cost( set, n, mask, best );
+		return( TRUE );
+	}
+	zeros = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * n );
+	ones = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * n );
+	for( int i = 0; i < MAX_CODES; i++ ) {
+		int j = word_size;
+		while( j-- ) {
+			word	k = ((word)1 ) << j;
+			COST	zero,
+				one,
+				here;
+			int	c0;
+
+			if(( mask[ i ] & k ) == 0 ) continue;
+			if((( c0 = divide_set( set, n, i, k, zeros, ones )) <= 0 )||( c0 == n )) continue;
+			mask[ i ] &= ~k;
+			(void)look_ahead( zeros, c0, mask, depth-1, &zero, NULL, NULL );
+			(void)look_ahead( ones, n - c0, mask, depth-1, &one, NULL, NULL );
+			mask[ i ] |= k;
+			join_cost( &zero, &one, &here );
+			if( !found || cheaper( &here, best )) {
+				found = TRUE;
+				*best = here;
+				if( w ) {
+					*w = i;
+					*b = j;
+				}
+			}
+		}
+	}
+	FREE( zeros );
+	FREE( ones );
+	if( !found ) estimate_cost( set, n, mask, best );
+	return( found );
+}
+
+/*
+ *	The exact strategy works on subsets of a short list, held as
+ *	bit sets of the instructions in it.  Each candidate split bit
+ *	has the set of instructions defining it and the set having it
+ *	as a one.  The best cost of every subset (measured as if it was
+ *	at the top of the list's subtree) is remembered.  Each thread
+ *	of a parallel build has its own.
+ */
+static _Thread_local INSTRUCTION	*exact_set[ MAX_EXACT ];
+static _Thread_local int	exact_splits,
+				exact_word[ MAX_CODES * WORD_BITS ],
+				exact_bit[ MAX_CODES * WORD_BITS ],
+				exact_defined[ MAX_CODES * WORD_BITS ],
+				exact_ones[ MAX_CODES * WORD_BITS ],
+				*exact_choice;
+static _Thread_local COST	*exact_cost;
+static _Thread_local bool	*exact_done;
+static _Thread_local word	*exact_mask;
+
+/*
+ *	Move a subset's cost down one level; every instruction walks
+ *	one more row, but with an error handler checks one less of its
+ *	own bits afterwards.
+ */
+static void exact_lower( COST *cost, int members ) {
+	if( error_handler ) {
+		cost->rows -= 2 * members;
+		cost->most -= 1;
+		cost->sum -= cost->weight;
+	}
+}
+
+/*
+ *	Work out the best cost of a subset.
+ */
+static COST *exact_solve( int subset ) {
+	COST	*best = &( exact_cost[ subset ]);
+
+	if( exact_done[ subset ]) return( best );
+	exact_done[ subset ] = TRUE;
+	exact_choice[ subset ] = -1;
+	if(( subset & ( subset - 1 )) == 0 ) {
+		int i = 0;
+
+		while(( subset >> i ) != 1 ) i++;
+		leaf_cost( exact_set[ i ], exact_mask, best );
+		return( best );
+	}
+	for( int c = 0; c < exact_splits; c++ ) {
+		int	s0 = subset & ~exact_ones[ c ],
+			s1 = subset & exact_ones[ c ];
+		COST	zero,
+			one,
+			here;
+
+		if(( subset & ~exact_defined[ c ])||( s0 == 0 )||( s1 == 0 )) continue;
+		zero = *exact_solve( s0 );
+		one = *exact_solve( s1 );
+		exact_lower( &zero, bit_count((word)s0 ));
+		exact_lower( &one, bit_count((word)s1 ));
+		join_cost( &zero, &one, &here );
+		if(( exact_choice[ subset ] < 0 )|| cheaper( &here, best )) {
+			*best = here;
+			exact_choice[ subset ] = c;
+		}
+	}
+	if( exact_choice[ subset ] < 0 ) {
+		/*
+		 *	Nothing divides this subset; it will not be
+		 *	picked unless there is no choice.
+		 */
+		best->rows = LONG_MAX / 2;
+		best->most = INT_MAX / 2;
+		best->weight = 0.0;
+		best->sum = DBL_MAX / 4;
+	}
+	return( best );
+}
+
+/*
+ *	Choose the split bit giving the best possible subtree for a
+ *	short list.  Returns FALSE when no bit divides the list.
+ */
+static bool exact_split( word *mask, INSTRUCTION *list, int count, int *w, int *b ) {
+	int	n = 0,
+		all = ( 1 << count ) - 1,
+		c;
+
+	for( INSTRUCTION *ptr = list; ptr; ptr = ptr->next ) exact_set[ n++ ] = ptr;
+	exact_splits = 0;
+	for( int i = 0; i < MAX_CODES; i++ ) {
+		int j = word_size;
+		while( j-- ) {
+			word	k = ((word)1 ) << j;
+			int	defined = 0,
+				ones = 0;
+
+			if(( mask[ i ] & k ) == 0 ) continue;
+			for( int m = 0; m < n; m++ ) {
+				if( MASK( exact_set[ m ], i ) & k ) defined |= 1 << m;
+				if( OPCODE( exact_set[ m ], i ) & k ) ones |= 1 << m;
+			}
+			exact_word[ exact_splits ] = i;
+			exact_bit[ exact_splits ] = j;
+			exact_defined[ exact_splits ] = defined;
+			exact_ones[ exact_splits ] = ones & defined;
+			exact_splits++;
+		}
+	}
+	exact_cost = (COST *)malloc( sizeof( COST ) << count );
+	exact_done = (bool *)malloc( sizeof( bool ) << count );
+	exact_choice = (int *)malloc( sizeof( int ) << count );
+	for( int s = 0; s <= all; exact_done[ s++ ] = FALSE );
+	exact_mask = mask;
+	(void)exact_solve( all );
+	if(( c = exact_choice[ all ]) >= 0 ) {
+		*w = exact_word[ c ];
+		*b = exact_bit[ c ];
+	}
+	FREE( exact_cost );
+	FREE( exact_done );
+	FREE( exact_choice );
+	return( c >= 0 );
+}
+
+/*
+ *	Choose the bit to split a list of instructions on by the
+ *	strategy selected.  Where a strategy cannot find a split that
+ *	divides the list it falls back to balance.
+ */
+static bool strategy_split( word *mask, INSTRUCTION *list, int count, int *w, int *b ) {
+	switch( split_strategy ) {
+		case ENTROPY_STRATEGY: {
+			return( entropy_split( mask, list, count, w, b ));
+		}
+		case LOOKAHEAD_STRATEGY: {
+			INSTRUCTION	**set;
+			COST		best;
+			bool		found;
+			int		n = 0;
+
+			set = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * count );
+			for( INSTRUCTION *ptr = list; ptr; ptr = ptr->next ) set[ n++ ] = ptr;
+			found = look_ahead( set, count, mask, LOOKAHEAD, &best, w, b );
+			FREE( set );
+			if( found ) return( TRUE );
+			break;
+		}
+		case EXACT_STRATEGY: {
+			if(( count <= MAX_EXACT )&& exact_split( mask, list, count, w, b )) return( TRUE );
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+	return( balance_split( mask, list, count, w, b ));
+}
+
+/*
+ *	Return the first opcode word holding an untested bit which every
+ *	instruction in the list defines (MAX_CODES if there is none).
+ */
+static int split_word( word *mask, INSTRUCTION *list ) {
+	for( int i = 0; i < MAX_CODES; i++ ) {
+		word	m = mask[ i ];
+
+		for( INSTRUCTION *ptr = list; ptr && m; ptr = ptr->next ) m &= MASK( ptr, i );
+		if( m ) return( i );
+	}
+	return( MAX_CODES );
+}
+
+/*
+ *	Choose the bit to split a list on.  With lazy fetching only the
+ *	first word which can split it is considered, so a later word is
+ *	tested (and fetched) only when the earlier ones cannot help.
+ */
+static bool choose_split( word *mask, INSTRUCTION *list, int count, int *w, int *b ) {
+	if( lazy_fetch ) {
+		word	first[ MAX_CODES ];
+		int	n = split_word( mask, list );
+
+		for( int i = 0; i < MAX_CODES; i++ ) first[ i ] = ( i <= n )? mask[ i ]: 0;
+		return( strategy_split( first, list, count, w, b ));
+	}
+	return( strategy_split( mask, list, count, w, b ));
+}
+
+/*
+ *	Define a subtree to be built, queued (when building in parallel)
+ *	for whichever thread gets to it first.  It has its own copy of
+ *	the mask of untested bits as the parent's changes.
+ */
+#define BUILD_TASK struct build_task
+BUILD_TASK {
+	word		mask[ MAX_CODES ];	/* Bits still to be tested			*/
+	INSTRUCTION	*list;			/* The instructions it separates		*/
+	int		count;			/* How many there are				*/
+	bool		done;			/* Built					*/
+	NODE		*result;		/* The subtree built				*/
+	BUILD_TASK	*prev,			/* Older task in the same queue			*/
+			*next;			/* Newer task					*/
+};
+
+/*
+ *	The parallel build.  Each thread (the main one being number 0)
+ *	queues the subtrees it forks at the new end of its own queue
+ *	and takes them back from there.  A thread with nothing to do
+ *	steals from the old end of another's queue, where the largest
+ *	subtrees are.  A thread waiting for a subtree builds others
+ *	meanwhile, so waits never deadlock.  One lock guards the lot,
+ *	the tasks being whole subtrees.
+ */
+static int		build_jobs = 1;
+static pthread_mutex_t	build_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	build_wake = PTHREAD_COND_INITIALIZER;
+static BUILD_TASK	**build_oldest = NULL,
+			**build_newest = NULL;
+static _Thread_local int	build_self = 0;
+
+static NODE *insert( word *mask, INSTRUCTION *list, int count );
+
+/*
+ *	Take a task to work on (with the lock held): the newest of this
+ *	thread's own, else the oldest of another thread's.  Returns NULL
+ *	when there are none.
+ */
+static BUILD_TASK *take_task( void ) {
+	BUILD_TASK	*task;
+	int		t;
+
+	if(( task = build_newest[ build_self ])) {
+		t = build_self;
+		if(( build_newest[ t ] = task->prev )) {
+			task->prev->next = NULL;
+		}
+		else {
+			build_oldest[ t ] = NULL;
+		}
+		return( task );
+	}
+	for( t = 1; t < build_jobs; t++ ) {
+		if(( task = build_oldest[( build_self + t ) % build_jobs ])) break;
+	}
+	if( task == NULL ) return( NULL );
+	t = ( build_self + t ) % build_jobs;
+	if(( build_oldest[ t ] = task->next )) {
+		task->next->prev = NULL;
+	}
+	else {
+		build_newest[ t ] = NULL;
+	}
+	return( task );
+}
+
+/*
+ *	Build the subtree of a task taken (with the lock held, which is
+ *	released while building).
+ */
+static void run_task( BUILD_TASK *task ) {
+	pthread_mutex_unlock( &build_lock );
+	task->result = insert( task->mask, task->list, task->count );
+	pthread_mutex_lock( &build_lock );
+	task->done = TRUE;
+	pthread_cond_broadcast( &build_wake );
+}
+
+/*
+ *	The work of each thread but the main one: build subtrees for
+ *	as long as the program runs.
+ */
+static void *build_worker( void *self ) {
+	BUILD_TASK	*task;
+
+	build_self = (int)(intptr_t)self;
+	pthread_mutex_lock( &build_lock );
+	while( TRUE ) {
+		if(( task = take_task())) {
+			run_task( task );
+		}
+		else {
+			pthread_cond_wait( &build_wake, &build_lock );
+		}
+	}
+	return( NULL );
+}
+
+/*
+ *	Start the threads of a parallel build, returning FALSE if they
+ *	could not be.
+ */
+static bool start_build( void ) {
+	pthread_t	thread;
+
+	build_oldest = (BUILD_TASK **)malloc( sizeof( BUILD_TASK * ) * build_jobs );
+	build_newest = (BUILD_TASK **)malloc( sizeof( BUILD_TASK * ) * build_jobs );
+	for( int i = 0; i < build_jobs; i++ ) build_oldest[ i ] = build_newest[ i ] = NULL;
+	for( int i = 1; i < build_jobs; i++ ) {
+		if( pthread_create( &thread, NULL, build_worker, (void *)(intptr_t)i )) return( FALSE );
+		pthread_detach( thread );
+	}
+	return( TRUE );
+}
+
+/*
+ *	Set up the building of a subtree, queueing it for any thread
+ *	when building in parallel and the list is long enough.
+ */
+static void fork_subtree( BUILD_TASK *task, word *mask, INSTRUCTION *list, int count ) {
+	for( int i = 0; i < MAX_CODES; i++ ) task->mask[ i ] = mask[ i ];
+	task->list = list;
+	task->count = count;
+	task->done = FALSE;
+	task->result = NULL;
+	if(( build_jobs > 1 )&&( count >= MIN_TASK )) {
+		pthread_mutex_lock( &build_lock );
+		task->next = NULL;
+		if(( task->prev = build_newest[ build_self ])) {
+			task->prev->next = task;
+		}
+		else {
+			build_oldest[ build_self ] = task;
+		}
+		build_newest[ build_self ] = task;
+		pthread_cond_signal( &build_wake );
+		pthread_mutex_unlock( &build_lock );
+	}
+}
+
+/*
+ *	Return the subtree of a task, building it here if nobody has
+ *	taken it, or building others while it is built elsewhere.
+ */
+static NODE *join_subtree( BUILD_TASK *task ) {
+	BUILD_TASK	*other;
+
+	if(( build_jobs <= 1 )||( task->count < MIN_TASK )) return( insert( task->mask, task->list, task->count ));
+	pthread_mutex_lock( &build_lock );
+	while( !task->done ) {
+		if(( other = take_task())) {
+			run_task( other );
+		}
+		else {
+			pthread_cond_wait( &build_wake, &build_lock );
+		}
+	}
+	pthread_mutex_unlock( &build_lock );
+	return( task->result );
+}
+
+/*
+ *	Recursive tree building routine.
+ *
+ *	Create tree using a binary division mechanism, or (when field
+ *	nodes have been enabled) by extracting the widest bit field
+ *	which divides the list cleanly.
+ */
+static NODE *insert( word *mask, INSTRUCTION *list, int count ) {
+	int		w,
+			b,
+			d,
+			n;
+	bool		v;
+	word		t;
+	NODE		*here;
+	INSTRUCTION	*ptr,
+			*ones,
+			*zeros;
+	int		c0,
+			c1;
+
+	/*
+	 *	Deal with up front cases first.
+	 */
+	if( count == 0 ) {
+		/* Error Leaf node time! */
+		return( new_node( NULL, 0, 0, 0 ));
+	}
+	if( count == 1 ) {
+		/*
+		 *	Brief duplication check:  Getting here should mean that
+		 *	the AND result of the mask value passed in and the mask
+		 * 	value of the instruction results in 0.  If there are n
+		 * 	bits still set then that instruction is accessible through
+		 * 	2^n alternative opcodes.
+		 */
+		count = 0;
+		for( int i = 0; i < list->elements; i++ ) {
+			list->unmatched[ i ] = t = mask[ i ] & list->mask[ i ];
+			for( int j = 0; j < word_size; j++ ) {
+				if( t & 1 ) count++;
+				t >>= 1;
+			}
+		}
+		/*
+		 *	How are we handling error/illegal instructions?
+		 */
+		if( count && error_handler ) {
+			/*
+			 *	Error handler defined, so we have to (carefully)
+			 *	force the system to carry on building the
+			 *	decision tree.
+			 *
+			 *	All we need to do here is find the first ambiguous
+			 *	opcode bit, decide which side this instruction goes,
+			 *	for a decision node and repeat recursive call.
+			 *
+			 *	With field nodes enabled the run of ambiguous bits
+			 *	starting at that bit is tested in one go.
+			 *
+			 *	We know that at least one of the unmatched[] elements
+			 *	is non-zero.  That is our target opcode word.
+			 */
+			for( int i = 0; i < list->elements; i++ ) {
+				if( list->unmatched[ i ]) {
+					/*
+					 *	Word i is where we make the decision.
+					 *
+					 *	step j through bits from msb to lsb.
+					 */
+					int j = word_size;
+					while( j-- ) {
+						word t = ((word)1 ) << j;
+						if( list->unmatched[ i ] & t ) {
+							/*
+							 *	Ambiguous bit found, with field nodes
+							 *	enabled widen this downwards to take in
+							 *	as many more ambiguous bits as we can.
+							 *	Other bits caught inside the field are
+							 *	either arguments or already tested, so
+							 *	their value does not affect the outcome.
+							 */
+							n = ( j < field_bits )? j+1: field_bits;
+							while(( n > 1 )&&( !( list->unmatched[ i ] & ( t >> ( n-1 ))))) n--;
+							b = j - n + 1;
+							t = field_mask( b, n ) & list->unmatched[ i ];
+							/*
+							 *	Create new node and put the instruction
+							 *	under every value of the field which
+							 *	matches its ambiguous bits.
+							 */
+							here = new_node( NULL, i, b, n );
+							mask[ i ] &= ~t;
+							for( int k = 0; k < ( 1 << n ); k++ ) {
+								if(((((word)k ) << b ) & t ) == ( list->opcode[ i ] & t )) {
+									here->child[ k ] = insert( mask, list, 1 );
+								}
+								else {
+									here->child[ k ] = insert( mask, NULL, 0 );
+								}
+							}
+							mask[ i ] |= t;
+							return( here );
+						}
+					}
+				}
+			}
+			/*
+			 *	If we fall out here then this IS a programming error.
+			 */
+			fprintf( stderr, "Coding error '%s' line %d.\n", __FILE__, __LINE__ );
+			exit( -1 );
+		}
+		/*
+		 *	No Error handler has been defined, so output this node
+		 *	with the duplication information attached to it.
+		 */
+		list->matches = 1 << count;
+		/* Leaf node time! */
+		return( new_node( list, 0, 0, 0 ));
+	}
+	/*
+	 *	The list is multiple options, so...
+	 *
+	 *	When field nodes are enabled look for the widest field of
+	 *	bits which every instruction in the list defines, and which
+	 *	spreads the list over more than half of the possible branches.
+	 *	Branches left empty become error leaves so, without an error
+	 *	handler, every branch must be used.
+	 *
+	 * 	w	The opcode number (0 .. MAX_CODES-1)
+	 *
+	 * 	b	The lowest bit number of the field
+	 *
+	 * 	n	The number of bits in the field (0 if none found)
+	 *
+	 * 	d	The number of branches used
+	 */
+	n = 0;
+	d = 0;
+	if( field_bits > 1 ) {
+		bool	used[ 1 << MAX_FIELD ];
+		int	last = ( lazy_fetch )? split_word( mask, list ): MAX_CODES - 1;
+
+		for( int i = 0; ( i <= last )&&( i < split_words ); i++ ) {
+			for( int j = word_size-1; j > 0; j-- ) {
+				for( int k = 2; ( k <= field_bits )&&( k <= j+1 ); k++ ) {
+					word	m = field_mask( j-k+1, k );
+					int	u;
+
+					/*
+					 *	Every bit in the field must be untested and
+					 *	defined by every instruction in the list.
+					 */
+					if(( mask[ i ] & m ) != m ) break;
+					for( ptr = list; ptr; ptr = ptr->next ) if(( MASK( ptr, i ) & m ) != m ) break;
+					if( ptr ) break;
+					/*
+					 *	How many branches are used?
+					 */
+					for( int l = 0; l < ( 1 << k ); used[ l++ ] = FALSE );
+					u = 0;
+					for( ptr = list; ptr; ptr = ptr->next ) {
+						int l = ( ptr->opcode[ i ] & m ) >> ( j-k+1 );
+						if( !used[ l ]) {
+							used[ l ] = TRUE;
+							u++;
+						}
+					}
+					if(( u * 2 > ( 1 << k ))&&(( u == ( 1 << k ))||( error_handler ))) {
+						if(( k > n )||(( k == n )&&( u > d ))) {
+							n = k;
+							d = u;
+							w = i;
+							b = j-k+1;
+						}
+					}
+				}
+			}
+		}
+	}
+	if( n ) {
+		INSTRUCTION	**lists[ 1 << MAX_FIELD ],
+				*heads[ 1 << MAX_FIELD ];
+		int		counts[ 1 << MAX_FIELD ];
+
+		/*
+		 *	Divide up the list (preserving its order) by the
+		 *	value of the field.
+		 */
+		t = field_mask( b, n );
+		for( int i = 0; i < ( 1 << n ); i++ ) {
+			heads[ i ] = NULL;
+			lists[ i ] = &( heads[ i ]);
+			counts[ i ] = 0;
+		}
+		while(( ptr = list )) {
+			int i = ( ptr->opcode[ w ] & t ) >> b;
+
+			list = list->next;
+			ptr->next = NULL;
+			*lists[ i ] = ptr;
+			lists[ i ] = &( ptr->next );
+			counts[ i ]++;
+		}
+		/*
+		 *	Make field node and process the branches.
+		 */
+		here = new_node( NULL, w, b, n );
+		mask[ w ] &= ~t;
+		if( build_jobs > 1 ) {
+			BUILD_TASK	*task;
+
+			/*
+			 *	Offer all but the first branch to other
+			 *	threads.
+			 */
+			task = (BUILD_TASK *)malloc( sizeof( BUILD_TASK ) << n );
+			for( int i = 1; i < ( 1 << n ); i++ ) fork_subtree( &( task[ i ]), mask, heads[ i ], counts[ i ]);
+			here->child[ 0 ] = insert( mask, heads[ 0 ], counts[ 0 ]);
+			for( int i = 1; i < ( 1 << n ); i++ ) here->child[ i ] = join_subtree( &( task[ i ]));
+			FREE( task );
+		}
+		else {
+			for( int i = 0; i < ( 1 << n ); i++ ) here->child[ i ] = insert( mask, heads[ i ], counts[ i ]);
+		}
+		mask[ w ] |= t;
+		return( here );
+	}
+	/*
+	 *	Find the word and bit which we will be using to
+	 *	split the list into two parts.
+	 *
+	 * 	w	The opcode number (0 .. MAX_CODES-1)
+	 *
+	 * 	b	The bit number (word_size-1 .. 0)
+	 *
+	 * 	v	true if a valid differentiation has been
+	 * 		located.
+	 */
+	v = choose_split( mask, list, count, &w, &b );
+	/*
+	 *	How did we do?
+	 */
+	if( !v ) {
+		/*
+		 *	There was no means to differentiate the instructions
+		 *	in the list..
+		 */
+		if( !trial_build ) {
+			pthread_mutex_lock( &build_lock );
+			fprintf( stderr, "----------------------\n" );
+			for( ptr = list; ptr; ptr = ptr->next ) {
+				fprintf( stderr, "Duplicate Instruction '%s' line %d.\n", ptr->name, ptr->line );
+				dropped++;
+			}
+			fprintf( stderr, "----------------------\n" );
+			pthread_mutex_unlock( &build_lock );
+		}
+		/* Error Leaf node time! */
+		return( new_node( NULL, 0, 0, 0 ));
+	}
+	/*
+	 *	Set the testing bit.
+	 */
+	t = ((word)1 ) << b;
+	/*
+	 *	Run through the list and divide up.
+	 */
+	ones = NULL;	c1 = 0;
+	zeros = NULL;	c0 = 0;
+	while(( ptr = list )) {
+		list = list->next;
+		if( ptr->opcode[ w ] & t ) {
+			ptr->next = ones;
+			ones = ptr;
+			c1++;
+		}
+		else {
+			ptr->next = zeros;
+			zeros = ptr;
+			c0++;
+		}
+	}
+	/*
+	 *	Make decision node and process the limbs.
+	 */
+	here = new_node( NULL, w, b, 1 );
+	mask[ w ] &= ~t;
+	if( build_jobs > 1 ) {
+		BUILD_TASK	task;
+
+		/*
+		 *	Offer the one branch to other threads.
+		 */
+		fork_subtree( &task, mask, ones, c1 );
+		ZERO( here ) = insert( mask, zeros, c0 );
+		ONE( here ) = join_subtree( &task );
+	}
+	else {
+		ZERO( here ) = insert( mask, zeros, c0 );
+		ONE( here ) = insert( mask, ones, c1 );
+	}
+	mask[ w ] |= t;
+	return( here );
+}
+
+/*
+ *	Build the decode tree for the instructions, which are given in
+ *	input order (insert() relinks the list as it divides it up).
+ */
+static NODE *build( INSTRUCTION **order, int count ) {
+	word	mask[ MAX_CODES ];
+
+	instructions = NULL;
+	split_words = 0;
+	for( int i = count; i--; instructions = order[ i ]) {
+		order[ i ]->next = instructions;
+		if( order[ i ]->elements > split_words ) split_words = order[ i ]->elements;
+	}
+	for( int i = 0; i < MAX_CODES; mask[ i++ ] = ~((word)0));
+	return( insert( mask, instructions, count ));
+}
+
+/*
+ *	Apply the R record weights to the instructions of each name.
+ */
+static void apply_rates( void ) {
+	for( RATE *r = rates; r; r = r->next ) {
+		bool	found = FALSE;
+
+		for( INSTRUCTION *ptr = instructions; ptr; ptr = ptr->next ) {
+			if( strcmp( ptr->name, r->name ) == 0 ) {
+				ptr->weight += r->weight;
+				found = TRUE;
+			}
+		}
+		if( !found ) {
+			fprintf( stderr, "Line %d: No instruction named '%s'.\n", r->line, r->name );
+			dropped++;
+		}
+	}
+}
+
+/*
+ *	Compare two opcode words (for qsort).
+ */
+static int compare_words( const void *a, const void *b ) {
+	word	x = *(const word *)a,
+		y = *(const word *)b;
+
+	return(( x < y )? -1: ( x > y ));
+}
+
+/*
+ *	Count the opcodes in a trace file against the instructions they
+ *	decode to, adding them to the instruction weights.  The file is
+ *	a sequence of the first words of the instructions executed, each
+ *	the word size rounded up to whole bytes, least significant byte
+ *	first.  An opcode matching more than one instruction is counted
+ *	against the one defining the most bits.
+ */
+static bool read_trace( const char *name ) {
+	FILE		*source;
+	int		size = ( word_size + 7 ) >> 3,
+			c;
+	long		ops = 0,
+			space = 0,
+			missed = 0;
+	word		*op = NULL,
+			value;
+
+	if(( source = fopen( name, "rb" )) == NULL ) {
+		fprintf( stderr, "Unable to open trace file '%s'.\n", name );
+		return( FALSE );
+	}
+	while(( c = fgetc( source )) != EOF ) {
+		value = c;
+		for( int i = 1; i < size; i++ ) {
+			if(( c = fgetc( source )) == EOF ) {
+				fprintf( stderr, "Trace file '%s' ends part way through an opcode.\n", name );
+				fclose( source );
+				return( FALSE );
+			}
+			value |= ((word)c ) << ( i << 3 );
+		}
+		if( ops == space ) {
+			space = ( space )? space << 1: 4096;
+			op = (word *)realloc( op, sizeof( word ) * space );
+		}
+		op[ ops++ ] = value;
+	}
+	fclose( source );
+	/*
+	 *	Sorting the trace means each distinct opcode only
+	 *	needs to be matched once.
+	 */
+	qsort( op, ops, sizeof( word ), compare_words );
+	for( long i = 0, j; i < ops; i = j ) {
+		INSTRUCTION	*best = NULL;
+
+		for( j = i+1; ( j < ops )&&( op[ j ] == op[ i ]); j++ );
+		for( INSTRUCTION *ptr = instructions; ptr; ptr = ptr->next ) {
+			if((( op[ i ] & ptr->mask[ 0 ]) == ptr->opcode[ 0 ])&&(( best == NULL )||( bit_count( ptr->mask[ 0 ]) > bit_count( best->mask[ 0 ])))) best = ptr;
+		}
+		if( best ) {
+			best->weight += j - i;
+		}
+		else {
+			missed += j - i;
+		}
+	}
+	if( op ) FREE( op );
+	fprintf( stderr, "Trace '%s': %ld opcodes, %ld not matching any instruction.\n", name, ops, missed );
+	return( TRUE );
+}
+
+/*
+ *	Add the share of all opcodes reaching each leaf below node (p
+ *	being the share reaching node) to the total of the instruction
+ *	it decodes, indexed by id.  With an error handler a field can
+ *	span operand bits, leaving an instruction under several leaves,
+ *	so each leaf only stands for its part of the instruction.
+ */
+static void leaf_shares( NODE *node, double p, double *total ) {
+	if( node->leaf ) {
+		if( node->decoded ) total[ node->decoded->id ] += p;
+		return;
+	}
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) leaf_shares( node->child[ i ], p / ( 1 << node->op_bits ), total );
+}
+
+/*
+ *	Return a new array of the shares of the leaves of a tree for
+ *	each of count instructions (see above).
+ */
+static double *tree_shares( NODE *tree, int count ) {
+	double	*total = (double *)malloc( sizeof( double ) * ( count + 1 ));
+
+	for( int i = 0; i <= count; total[ i++ ] = 0.0 );
+	leaf_shares( tree, 1.0, total );
+	return( total );
+}
+
+/*
+ *	Add up the weight of each instruction times the number of rows
+ *	walked (including the leaf row) to reach it, each leaf taking
+ *	its part of the weight.
+ */
+static double walk_sum( NODE *node, int rows, double p, double *total ) {
+	double	sum = 0.0;
+
+	if( node->leaf ) return(( node->decoded )? (double)node->decoded->weight * rows * p / total[ node->decoded->id ]: 0.0 );
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) sum += walk_sum( node->child[ i ], rows+1, p / ( 1 << node->op_bits ), total );
+	return( sum );
+}
+
+/*
+ *	Return the weighted total of the walks to count instructions.
+ */
+static double weighted_walk( NODE *tree, int count ) {
+	double	*total = tree_shares( tree, count ),
+		sum = walk_sum( tree, 1, 1.0, total );
+
+	FREE( total );
+	return( sum );
+}
+
+/*
+ *	Sequence the table into a conceptual array.
+ */
+static int sequence( NODE *node, int index ) {
+	node->index = index++;
+	if( !node->leaf ) {
+		index = sequence( FALL( node ), index );
+		index = sequence( JUMP( node ), index );
+	}
+	return( index );
+}
+
+/*
+ *	Mark every node of a (shared) tree as not yet given a row.
+ */
+static void unplace( NODE *node ) {
+	node->index = -1;
+	if( !node->leaf ) {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) unplace( node->child[ i ]);
+	}
+}
+
+/*
+ *	Sequence a shared tree into the rows of the table.  The zero
+ *	branch of a node has to be the following row, so it is always
+ *	given one (a copy if the node already has a row elsewhere).  The
+ *	one branch is reached by the jump, so a node which already has a
+ *	row is simply jumped to, wherever it is.
+ */
+static int sequence_shared( NODE **rows, NODE *node, int index ) {
+	if( node->index < 0 ) node->index = index;
+	rows[ index++ ] = node;
+	if( !node->leaf ) {
+		index = sequence_shared( rows, FALL( node ), index );
+		if( JUMP( node )->index < 0 ) index = sequence_shared( rows, JUMP( node ), index );
+	}
+	return( index );
+}
+
+/*
+ *	Sequence the table for the field layout, where the children of
+ *	a decision node occupy a contiguous block of rows (indexed by the
+ *	value of the field) and the node itself records where that block
+ *	starts.  The node has already been given its index by its parent.
+ *
+ *	When subtrees are shared a node can be met more than once, but
+ *	its block of children is only given rows the first time.
+ */
+static int sequence_fields( NODE *node, int index ) {
+	if( !node->leaf && !node->base ) {
+		node->base = index;
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) node->child[ i ]->index = index++;
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) index = sequence_fields( node->child[ i ], index );
+	}
+	return( index );
+}
+
+/*
+ *	Enter the nodes into the array of output table rows.
+ */
+static void place( NODE **rows, NODE *node ) {
+	rows[ node->index ] = node;
+	if( !node->leaf ) {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) place( rows, node->child[ i ]);
+	}
+}
+
+/*
+ *	Enter the nodes into the rows of the field layout, a block of
+ *	children at a time.  A shared node fills its block only once.
+ */
+static void place_fields( NODE **rows, NODE *node ) {
+	if( !node->leaf && ( rows[ node->base ] == NULL )) {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) rows[ node->base + i ] = node->child[ i ];
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) place_fields( rows, node->child[ i ]);
+	}
+}
+
+/*
+ *	Return the number of rows the field layout of a tree needs
+ *	when nothing is shared.
+ */
+static int count_rows( NODE *node ) {
+	int	rows = 1;
+
+	if( !node->leaf ) {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) rows += count_rows( node->child[ i ]);
+	}
+	return( rows );
+}
+
+/*
+ *	Table layouts.
+ *
+ *	In the field layout every decision node has a block of rows for
+ *	its children which can go anywhere in the table, so the blocks
+ *	can be put in whatever order keeps the walk in the fewest cache
+ *	lines.  DEPTH is the order of sequence_fields() above, BREADTH
+ *	orders the blocks a level at a time (as an Eytzinger layout),
+ *	VEB orders them recursively by height (van Emde Boas) and
+ *	BLOCKED fills each cache line with the top of a subtree before
+ *	starting the next line with the subtrees left over.
+ */
+
+/*
+ *	Clear the child block of every node of a (shared) tree.
+ */
+static void unbase( NODE *node ) {
+	node->base = 0;
+	if( !node->leaf ) {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) unbase( node->child[ i ]);
+	}
+}
+
+/*
+ *	Return the number of levels of decision nodes in a tree.
+ */
+static int tree_height( NODE *node ) {
+	int	h = 0;
+
+	if( !node->leaf ) {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) {
+			int c = tree_height( node->child[ i ]);
+			if( c > h ) h = c;
+		}
+		h++;
+	}
+	return( h );
+}
+
+/*
+ *	Add a decision node to the order its block is given rows in,
+ *	if it is not there already.
+ */
+static int order_node( NODE *node, NODE **order, int count ) {
+	if( !node->leaf && !node->base ) {
+		node->base = -1;
+		order[ count++ ] = node;
+	}
+	return( count );
+}
+
+/*
+ *	Van Emde Boas order of the top levels of a subtree: the top
+ *	half of the levels first, then each of the subtrees hanging
+ *	below them.
+ */
+static int veb_bottom( NODE *node, int depth, int levels, NODE **order, int count );
+static int veb_order( NODE *node, int levels, NODE **order, int count ) {
+	int	top;
+
+	if( node->leaf ||( levels <= 0 )) return( count );
+	if( levels == 1 ) return( order_node( node, order, count ));
+	top = ( levels + 1 ) >> 1;
+	count = veb_order( node, top, order, count );
+	return( veb_bottom( node, top, levels - top, order, count ));
+}
+
+/*
+ *	Order each subtree found depth levels below a node.
+ */
+static int veb_bottom( NODE *node, int depth, int levels, NODE **order, int count ) {
+	if( node->leaf ) return( count );
+	if( depth == 0 ) return( veb_order( node, levels, order, count ));
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) count = veb_bottom( node->child[ i ], depth-1, levels, order, count );
+	return( count );
+}
+
+/*
+ *	Give blocks to the subtree below a node a cache line at a time,
+ *	returning the next free row.  The block of a node starts a new
+ *	line unless it fits in what is left of the current one, and the
+ *	blocks below it follow (a level at a time) while they fit in the
+ *	same line.  Those which do not are left for lines of their own.
+ */
+static int block_lines( NODE *tree, int index, int size ) {
+	int	line_rows = ( cache_line >= row_bytes )? cache_line / row_bytes: 1,
+		head = 0,
+		tail = 0,
+		l_head,
+		l_tail,
+		first,
+		n;
+	NODE	**pending,
+		**local;
+
+	pending = (NODE **)malloc( sizeof( NODE * ) * size );
+	local = (NODE **)malloc( sizeof( NODE * ) * size );
+	pending[ tail++ ] = tree;
+	while( head < tail ) {
+		NODE *root = pending[ head++ ];
+
+		if( root->leaf || root->base ) continue;
+		/*
+		 *	Start a new line for this subtree unless it fits.
+		 */
+		n = 1 << root->op_bits;
+		if(( index % line_rows )&&(( index % line_rows ) + n > line_rows )) index += line_rows - ( index % line_rows );
+		first = index / line_rows;
+		root->base = index;
+		index += n;
+		/*
+		 *	Fill the rest of the line a level at a time.
+		 */
+		l_head = l_tail = 0;
+		for( int i = 0; i < n; i++ ) local[ l_tail++ ] = root->child[ i ];
+		while( l_head < l_tail ) {
+			NODE *node = local[ l_head++ ];
+
+			if( node->leaf || node->base ) continue;
+			n = 1 << node->op_bits;
+			if((( index + n - 1 ) / line_rows == first )&&( l_tail + n <= size )) {
+				node->base = index;
+				index += n;
+				for( int i = 0; i < n; i++ ) local[ l_tail++ ] = node->child[ i ];
+			}
+			else {
+				if( tail < size ) pending[ tail++ ] = node;
+			}
+		}
+	}
+	FREE( pending );
+	FREE( local );
+	return( index );
+}
+
+/*
+ *	Give every decision node's block of children its rows by the
+ *	layout, returning the number of rows in the table (row zero
+ *	being the root).  Rows left empty are padding.
+ */
+static int layout_fields( NODE *tree, int layout ) {
+	NODE	**order;
+	int	size,
+		count,
+		index;
+
+	unbase( tree );
+	switch( layout ) {
+		case BREADTH_LAYOUT:
+		case VEB_LAYOUT: {
+			size = count_rows( tree );
+			order = (NODE **)malloc( sizeof( NODE * ) * size );
+			if( layout == BREADTH_LAYOUT ) {
+				count = order_node( tree, order, 0 );
+				for( int i = 0; i < count; i++ ) {
+					for( int j = 0; j < ( 1 << order[ i ]->op_bits ); j++ ) count = order_node( order[ i ]->child[ j ], order, count );
+				}
+			}
+			else {
+				count = veb_order( tree, tree_height( tree ), order, 0 );
+			}
+			index = 1;
+			for( int i = 0; i < count; i++ ) {
+				order[ i ]->base = index;
+				index += 1 << order[ i ]->op_bits;
+			}
+			FREE( order );
+			return( index );
+		}
+		case BLOCKED_LAYOUT: {
+			size = count_rows( tree );
+			return( block_lines( tree, 1, size ));
+		}
+		default: {
+			return( sequence_fields( tree, 1 ));
+		}
+	}
+}
+
+/*
+ *	Add up the cache lines read by the walk to each leaf (a line
+ *	only counted once however many of its rows are read), times the
+ *	chance of that leaf; its weight, or its share of all opcodes
+ *	when there are no weights.  The table is taken to start on a
+ *	line.
+ */
+static double cache_lines( NODE *node, int row, int *line, int depth, double p, double *total ) {
+	int	l = (int)(((long)row * row_bytes ) / cache_line ),
+		n;
+	double	sum = 0.0;
+
+	for( n = 0; ( n < depth )&&( line[ n ] != l ); n++ );
+	if( n == depth ) line[ depth++ ] = l;
+	if( node->leaf ) {
+		double w = ( weighted )? (( node->decoded )? (double)node->decoded->weight: 0.0 ): p;
+
+		*total += w;
+		return( w * depth );
+	}
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) {
+		NODE	*c = node->child[ i ];
+		int	r;
+
+		if( field_rows ) {
+			r = node->base + i;
+		}
+		else {
+			r = ( c == FALL( node ))? row + 1: c->index;
+		}
+		sum += cache_lines( c, r, line, depth, p / (double)( 1 << node->op_bits ), total );
+	}
+	return( sum );
+}
+
+/*
+ *	Return the expected cache lines read per decode.  The size of
+ *	the table is not needed, but makes for a neater call.
+ */
+static double expected_lines( NODE *tree, int size ) {
+	int	line[ MAX_CODES * 64 + 1 ];
+	double	total = 0.0,
+		lines;
+
+	(void)size;
+	lines = cache_lines( tree, 0, line, 0, 1.0, &total );
+	return(( total > 0.0 )? lines / total: 0.0 );
+}
+
+/*
+ *	Report the expected cache lines read per decode for a layout.
+ */
+static double report_layout( const char *name, NODE *tree, int size ) {
+	double	lines = expected_lines( tree, size );
+
+	fprintf( stderr, "Layout %s: %d rows, %.3f cache lines of %d bytes per decode.\n", name, size, lines, cache_line );
+	return( lines );
+}
+
+/*
+ *	Return the words read by the walks below a node (weighted, or
+ *	by the share of opcodes p reaching it) when each is fetched the
+ *	first time it is tested, 'loaded' holding those already read.
+ *	The total weight of the leaves is added to 'total'.
+ */
+static double words_fetched( NODE *node, unsigned loaded, double p, double *total ) {
+	double	sum = 0.0;
+
+	if( node->leaf ) {
+		double	w = ( weighted )? (( node->decoded )? (double)node->decoded->weight: 0.0 ): p;
+		int	n = 0;
+
+		for( ; loaded; loaded &= loaded - 1 ) n++;
+		*total += w;
+		return( w * n );
+	}
+	loaded |= 1u << node->op_word;
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) {
+		sum += words_fetched( node->child[ i ], loaded, p / (double)( 1 << node->op_bits ), total );
+	}
+	return( sum );
+}
+
+/*
+ *	Return the total weight of the instructions below a node.
+ */
+static double subtree_weight( NODE *node ) {
+	double	sum = 0.0;
+
+	if( node->leaf ) return(( node->decoded )? (double)node->decoded->weight: 0.0 );
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) sum += subtree_weight( node->child[ i ]);
+	return( sum );
+}
+
+/*
+ *	Sequence the one bit table into rows (enough for the tree with
+ *	nothing shared), returning the number of rows used.
+ */
+static int sequence_rows( NODE **rows, NODE *tree ) {
+	int	size;
+
+	if( share_subtrees ) {
+		unplace( tree );
+		return( sequence_shared( rows, tree, 0 ));
+	}
+	size = sequence( tree, 0 );
+	place( rows, tree );
+	return( size );
+}
+
+/*
+ *	Choose which child of each one bit node is the following row.
+ *	Starting with the likelier child (by weight) following, each
+ *	node in turn is inverted if that cuts the cache lines read per
+ *	decode, until no node can be improved.
+ */
+static void choose_fall( NODE *tree, NODE **rows ) {
+	NODE	**nodes;
+	int	size,
+		count = 0;
+	double	best,
+		lines;
+	bool	better;
+
+	size = sequence_rows( rows, tree );
+	nodes = (NODE **)malloc( sizeof( NODE * ) * size );
+	for( int i = 0; i < size; i++ ) {
+		NODE *n = rows[ i ];
+
+		if( !n->leaf &&( n->index == i )) {
+			n->invert = weighted &&( subtree_weight( ONE( n )) > subtree_weight( ZERO( n )));
+			nodes[ count++ ] = n;
+		}
+	}
+	best = expected_lines( tree, sequence_rows( rows, tree ));
+	do {
+		better = FALSE;
+		for( int i = 0; i < count; i++ ) {
+			nodes[ i ]->invert = !nodes[ i ]->invert;
+			lines = expected_lines( tree, sequence_rows( rows, tree ));
+			if( lines < best - 1e-9 ) {
+				best = lines;
+				better = TRUE;
+			}
+			else {
+				nodes[ i ]->invert = !nodes[ i ]->invert;
+			}
+		}
+	} while( better );
+	FREE( nodes );
+}
+
+
+/*
+ *	Add the walks below node (reached by the share p of opcodes)
+ *	to the measures of a tree, each leaf taking its part of the
+ *	weight of its instruction.
+ */
+static void measure_walks( NODE *node, int walk, double p, double *total, COST *cost ) {
+	if( node->leaf ) {
+		if( walk > cost->most ) cost->most = walk;
+		if( node->decoded ) {
+			double	w = walk_weight( node->decoded ) * p / total[ node->decoded->id ];
+
+			cost->weight += w;
+			cost->sum += w * walk;
+		}
+	}
+	else {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) measure_walks( node->child[ i ], walk+1, p / ( 1 << node->op_bits ), total, cost );
+	}
+}
+
+/*
+ *	Measure a tree of count instructions; the rows of the table
+ *	(with nothing shared), the longest walk to any leaf and the
+ *	weighted total of the walks to each instruction.
+ */
+static void measure( NODE *tree, int count, COST *cost ) {
+	double	*total = tree_shares( tree, count );
+
+	cost->rows = count_rows( tree );
+	cost->most = 0;
+	cost->weight = 0.0;
+	cost->sum = 0.0;
+	measure_walks( tree, 1, 1.0, total, cost );
+	FREE( total );
+}
+
+/*
+ *	Report the measures of a tree.
+ */
+static void report_cost( const char *name, COST *cost ) {
+	fprintf( stderr, "Strategy %s: %ld rows, longest walk %d rows, average walk %.3f rows.\n",
+			name, cost->rows, cost->most,
+			( cost->weight > 0.0 )? cost->sum / cost->weight: 0.0 );
+}
+
+/*
+ *	Gather the statistics of a tree (which must not be shared) for
+ *	the leaves below node, at the depth given, reached by the share
+ *	given of all opcodes.  The histograms must have room for the
+ *	height of the tree, and the instruction arrays for every id
+ *	(the least depths starting at INT_MAX and the most at -1).
+ */
+static void gather_stats( NODE *node, int depth, double share, TREE_STATS *stats ) {
+	INSTRUCTION	*ptr = node->decoded;
+
+	if( depth > stats->height ) stats->height = depth;
+	if( !node->leaf ) {
+		stats->nodes++;
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) {
+			gather_stats( node->child[ i ], depth+1, share / ( 1 << node->op_bits ), stats );
+		}
+		return;
+	}
+	stats->expected += share * depth;
+	if( ptr == NULL ) {
+		stats->errors++;
+		stats->missed[ depth ]++;
+		return;
+	}
+	stats->leaves++;
+	stats->found[ depth ]++;
+	if( ptr->matches > 1 ) stats->aliased++;
+	if( depth < stats->least[ ptr->id ]) stats->least[ ptr->id ] = depth;
+	if( depth > stats->most[ ptr->id ]) stats->most[ ptr->id ] = depth;
+	stats->share[ ptr->id ] += share;
+	stats->depth[ ptr->id ] += share * depth;
+}
+
+/*
+ *	Gather the statistics of a whole tree, before the output can
+ *	share any of it.
+ */
+static void tree_stats( NODE *tree, int count, TREE_STATS *stats ) {
+	int	height = tree_height( tree );
+
+	stats->nodes = 0;
+	stats->leaves = 0;
+	stats->errors = 0;
+	stats->aliased = 0;
+	stats->height = 0;
+	stats->expected = 0.0;
+	stats->found = (long *)malloc( sizeof( long ) * ( height + 1 ));
+	stats->missed = (long *)malloc( sizeof( long ) * ( height + 1 ));
+	for( int i = 0; i <= height; i++ ) {
+		stats->found[ i ] = 0;
+		stats->missed[ i ] = 0;
+	}
+	stats->least = (int *)malloc( sizeof( int ) * ( count + 1 ));
+	stats->most = (int *)malloc( sizeof( int ) * ( count + 1 ));
+	stats->share = (double *)malloc( sizeof( double ) * ( count + 1 ));
+	stats->depth = (double *)malloc( sizeof( double ) * ( count + 1 ));
+	for( int i = 0; i <= count; i++ ) {
+		stats->least[ i ] = INT_MAX;
+		stats->most[ i ] = -1;
+		stats->share[ i ] = 0.0;
+		stats->depth[ i ] = 0.0;
+	}
+	gather_stats( tree, 0, 1.0, stats );
+}
+
+/*
+ *	Write a string to the JSON report, quoted and escaped.
+ */
+static void json_string( const char *s ) {
+	putchar( '"' );
+	for( ; *s; s++ ) {
+		if(( *s == '"' )||( *s == '\\' )) {
+			printf( "\\%c", *s );
+		}
+		else {
+			if(( unsigned char )*s < 0x20 ) {
+				printf( "\\u%04X", ( unsigned char )*s );
+			}
+			else {
+				putchar( *s );
+			}
+		}
+	}
+	putchar( '"' );
+}
+
+/*
+ *	Write a count to the JSON report, null when it is not known.
+ */
+static void json_count( const char *name, long value, const char *sep ) {
+	if( value ) {
+		printf( "\t\t\"%s\": %ld%s\n", name, value, sep );
+	}
+	else {
+		printf( "\t\t\"%s\": null%s\n", name, sep );
+	}
+}
+
+/*
+ *	Write the statistics of the tree and of the table output to the
+ *	standard output as JSON, then release them.  An instruction
+ *	which no opcode reaches (one reported as a duplicate) has null
+ *	depths.
+ */
+static void write_stats( TREE_STATS *stats, INSTRUCTION **order, int count, unsigned long total_weight ) {
+	double	weighted = 0.0;
+
+	printf( "{\n" );
+	printf( "\t\"input\": " );
+	json_string( input_source_file );
+	printf( ",\n\t\"word_size\": %d,\n\t\"words\": %d,\n\t\"instructions\": %d,\n", word_size, maximum_words, count );
+	printf( "\t\"tree\": {\n" );
+	printf( "\t\t\"nodes\": %d,\n", stats->nodes );
+	printf( "\t\t\"leaves\": %d,\n", stats->leaves );
+	printf( "\t\t\"error_leaves\": %d,\n", stats->errors );
+	printf( "\t\t\"aliased_leaves\": %d,\n", stats->aliased );
+	printf( "\t\t\"height\": %d\n", stats->height );
+	printf( "\t},\n" );
+	printf( "\t\"table\": {\n" );
+	printf( "\t\t\"form\": \"%s\",\n", table_form );
+	printf( "\t\t\"field_bits\": %d,\n", ( field_bits > 1 )? field_bits: 1 );
+	printf( "\t\t\"shared\": %s,\n", ( share_subtrees )? "true": "false" );
+	json_count( "entries", table_entries, "," );
+	json_count( "entry_bytes", table_entry_bytes, "," );
+	json_count( "bytes", table_bytes, "" );
+	printf( "\t},\n" );
+	/*
+	 *	The depths of the leaves.
+	 */
+	printf( "\t\"depth\": {\n" );
+	printf( "\t\t\"histogram\": [" );
+	for( int i = 0; i <= stats->height; i++ ) printf( "%s%ld", ( i )? ", ": " ", stats->found[ i ]);
+	printf( " ],\n" );
+	printf( "\t\t\"error_histogram\": [" );
+	for( int i = 0; i <= stats->height; i++ ) printf( "%s%ld", ( i )? ", ": " ", stats->missed[ i ]);
+	printf( " ],\n" );
+	printf( "\t\t\"expected\": %.3f,\n", stats->expected );
+	for( int i = 1; i <= count; i++ ) {
+		if( stats->share[ i ] > 0.0 ) weighted += (double)order[ i-1 ]->weight * stats->depth[ i ] / stats->share[ i ];
+	}
+	if( total_weight ) {
+		printf( "\t\t\"weighted\": %.3f\n", weighted / total_weight );
+	}
+	else {
+		printf( "\t\t\"weighted\": null\n" );
+	}
+	printf( "\t},\n" );
+	/*
+	 *	And of each instruction.
+	 */
+	printf( "\t\"instruction_depths\": [\n" );
+	for( int i = 1; i <= count; i++ ) {
+		INSTRUCTION	*ptr = order[ i-1 ];
+
+		printf( "\t\t{ \"name\": " );
+		json_string( ptr->name );
+		printf( ", \"line\": %d, \"weight\": %lu, ", ptr->line, ptr->weight );
+		if( stats->share[ i ] > 0.0 ) {
+			printf( "\"min\": %d, \"avg\": %.3f, \"max\": %d }", stats->least[ i ], stats->depth[ i ] / stats->share[ i ], stats->most[ i ]);
+		}
+		else {
+			printf( "\"min\": null, \"avg\": null, \"max\": null }" );
+		}
+		printf( "%s\n", ( i < count )? ",": "" );
+	}
+	printf( "\t]\n" );
+	printf( "}\n" );
+	FREE( stats->found );
+	FREE( stats->missed );
+	FREE( stats->least );
+	FREE( stats->most );
+	FREE( stats->share );
+	FREE( stats->depth );
+}
+
+/*
+ *	Output the result values for a leaf, one per F record, each
+ *	preceded by lead.  With no F records the name is used as is.
+ */
+static void emit_values( const char *lead, const char *name ) {
+	if( output_formats ) {
+		for( int i = 0; i < output_formats; i++ ) {
+			fprintf( output_source, "%s%s%s%s",
+					lead,
+					output_format_a[ i ],
+					name,			/* Leaf node function name */
+					output_format_b[ i ]);
+			lead = ", ";
+		}
+	}
+	else {
+		fprintf( output_source, "%s%s", lead, name );		/* Leaf node function name */
+	}
+}
+
+/*
+ *	Close a leaf row, adding the commentary describing the instruction
+ *	(or lack of one) that the row decodes to.
+ */
+static void emit_leaf_comment( INSTRUCTION *ptr, int row, char sep ) {
+	word		look;
+
+	if( ptr ) {
+		fprintf( output_source, " }%c\t%s [%3d]%3d",
+				sep,
+				output_comment_a,
+				row,			/* The index number of this row */
+				ptr->line );		/* The line number of the configuration file */
+		for( int i = 0; i < ptr->elements; i++ ) {
+			if( ptr->description[ i ]) {
+				fprintf( output_source, "\t%s", ptr->description[ i ]);
+			}
+		}
+		if( ptr->matches > 1 ) {
+			fprintf( output_source, " [%d", ptr->matches );
+			for( int i = 0; i < ptr->elements; i++ ) {
+				if( ptr->description[ i ]) {
+					look = ((word)1 ) << ( strlen( ptr->description[ i ])-1 );
+					fprintf( output_source, " " );
+					while( look ) {
+						if( ptr->unmatched[ i ] & look ) {
+							fprintf( output_source, "%c", PLACE_VARIABLE );
+						}
+						else {
+							fprintf( output_source, "%c", (( look & PLACE_PATTERN )? PLACE_MARK: PLACE_GAP ));
+						}
+						look >>= 1;
+					}
+					fprintf( output_source, "]" );
+				}
+			}
+		}
+		fprintf( output_source, " %s %s\n",
+			ptr->comment,		/* The commentary text associated with this line */
+			output_comment_b );
+	}
+	else {
+		/*
+		 *	Not a decoded instruction, an illegal one.
+		 */
+		fprintf( output_source, " }%c\t%s [%3d]\tInvalid Instruction %s\n",
+			sep,
+			output_comment_a,
+			row,			/* The index number of this row */
+			output_comment_b );
+	}
+}
+
+/*
+ *	Output a single row of the decoder table.
+ */
+static void emit_decoder( NODE *node, int row, bool last ) {
+	char		sep;
+
+	sep = last?' ':',';
+	
+	if( node->leaf ) {
+		if( maximum_words > 1 ) {
+			fprintf( output_source, "\t{ 0, " );
+		}
+		else {
+			fprintf( output_source, "\t{ " );
+		}
+		fprintf( output_source, ( field_rows || invert_tests )? "0, 0, 0": "0, 0" );
+		if( constexpr_output ) {
+			/*
+			 *	The values are the leaf member of the row.
+			 */
+			emit_values( ", { ", ( node->decoded )? node->decoded->name: error_handler );
+			fprintf( output_source, " }" );
+		}
+		else {
+			emit_values( ", ", ( node->decoded )? node->decoded->name: error_handler );
+		}
+		emit_leaf_comment( node->decoded, row, sep );
+	}
+	else {
+		const char	*fmt;
+
+		if( node->op_word >= maximum_words ) {
+			fprintf( stderr, "Maximum words value exceeded at array index %d.\n", row );
+			dropped++;
+		}
+		if( maximum_words > 1 ) {
+			fprintf( output_source, "\t{ %d, ", node->op_word );
+		}
+		else {
+			fprintf( output_source, "\t{ " );
+		}
+		switch( word_size ) {
+			case 8: {
+				fmt = "0x%02" PRIX64 ", %d";
+				break;
+			}
+			case 16: {
+				fmt = "0x%04" PRIX64 ", %d";
+				break;
+			}
+			case 32: {
+				fmt = "0x%08" PRIX64 ", %d";
+				break;
+			}
+			case 64: {
+				fmt = "0x%016" PRIX64 ", %d";
+				break;
+			}
+			default: {
+				fmt = "0x%" PRIX64 ", %d";
+				break;
+			}
+		}
+		if( field_rows ) {
+			/*
+			 *	Field layout: mask, shift and the relative
+			 *	distance to the block of children.
+			 */
+			fprintf( output_source, fmt,
+				(uint64_t)field_mask( node->op_bit, node->op_bits ),
+				node->op_bit );
+			fprintf( output_source, ", %d",
+				node->base - row );		/* Relative distance down array */
+		}
+		else {
+			if( invert_tests ) {
+				/*
+				 *	The flip is the mask when the one branch
+				 *	is the following row.
+				 */
+				char	hex[ 16 ];
+
+				strcpy( hex, fmt );
+				*strchr( hex, ',' ) = EOS;
+				fprintf( output_source, hex, (uint64_t)(((word)1) << node->op_bit ));
+				fprintf( output_source, ", " );
+				fprintf( output_source, hex, (uint64_t)(( node->invert )? (((word)1) << node->op_bit ): 0 ));
+				fprintf( output_source, ", %d", JUMP( node )->index - row );	/* Relative distance down array */
+			}
+			else {
+				fprintf( output_source, fmt,
+					(uint64_t)(((word)1) << node->op_bit ),
+					JUMP( node )->index - row );	/* Relative distance down array */
+			}
+		}
+		if( constexpr_output ) {
+			fprintf( output_source, ", {}" );
+		}
+		else {
+			if( output_formats ) {
+				for( int i = 0; i < output_formats; i++ ) fprintf( output_source, ", NULL" );
+			}
+			else {
+				fprintf( output_source, ", NULL" );
+			}
+		}
+		fprintf( output_source, " }%c\t%s [%3d]\t%s\n",
+			sep,
+			output_comment_a,
+			row,				/* The index number of this row */
+			output_comment_b );
+	}
+}
+
+/*
+ *	Include (once) the fixed width integer types in the source file.
+ */
+static void emit_stdint( void ) {
+	if( stdint_output ) return;
+	stdint_output = TRUE;
+	fprintf( output_source, "#include <stdint.h>\n" );
+}
+
+/*
+ *	Output a comment block to the source file in the style of the
+ *	selected language, one line of comment per argument.  The list
+ *	of lines is terminated with a NULL.
+ */
+static void emit_comment( const char *text, ... ) {
+	va_list	args;
+
+	fprintf( output_source, "%s\n", output_comment_a );
+	va_start( args, text );
+	while( text ) {
+		if( strlen( output_comment_b )) {
+			/*
+			 *	C style start to end comments
+			 */
+			fprintf( output_source, "\t%s\n", text );
+		}
+		else {
+			/*
+			 *	C++ style start to end comments
+			 */
+			fprintf( output_source, "%s\t%s\n", output_comment_a, text );
+		}
+		text = va_arg( args, const char * );
+	}
+	va_end( args );
+	fprintf( output_source, "%s\n", ( strlen( output_comment_b ))? output_comment_b: output_comment_a );
+}
+
+/*
+ *	Return the name of the smallest standard integer type which
+ *	can hold an opcode word.
+ */
+static const char *word_type( void ) {
+	if( word_size <= 8 ) return( "uint8_t" );
+	if( word_size <= 16 ) return( "uint16_t" );
+	if( word_size <= 32 ) return( "uint32_t" );
+	return( "uint64_t" );
+}
+
+/*
+ *	Return the name of the smallest standard integer type which
+ *	can hold numbers up to n.
+ */
+static const char *id_type( int n ) {
+	if( n <= 0xFF ) return( "uint8_t" );
+	if( n <= 0xFFFF ) return( "uint16_t" );
+	return( "uint32_t" );
+}
+
+/*
+ *	Output the opening of an array of count elements of the given
+ *	type, either as a plain C array (qualified as given) or as a
+ *	C++ constexpr std::array, optionally aligned to a cache line.
+ */
+static void emit_array_open( const char *qualifier, const char *type, const char *name, long count, bool aligned ) {
+	if( aligned ) fprintf( output_source, ( output_cpp )? "alignas( %d ) ": "_Alignas( %d ) ", cache_line );
+	if( constexpr_output ) {
+		fprintf( output_source, "%s constexpr std::array< %s, %ld > %s = {{\n", data_scope, type, count, name );
+	}
+	else {
+		fprintf( output_source, "%s %s%s %s[ %ld ] = {\n", data_scope, qualifier, type, name, count );
+	}
+}
+
+/*
+ *	Output the closing of an array.
+ */
+static void emit_array_close( void ) {
+	fprintf( output_source, ( constexpr_output )? "}};\n": "};\n" );
+}
+
+/*
+ *	Output the opening line of the routine which finds the leaf
+ *	for an opcode, passed as an array when more than one word is
+ *	needed.
+ */
+static void emit_find_open( void ) {
+	if( constexpr_output ) {
+		fprintf( output_source, "%s constexpr const %s *%s_find( ", data_scope, data_type, data_name );
+	}
+	else {
+		fprintf( output_source, "%s %s *%s_find( ", data_scope, data_type, data_name );
+	}
+	if( maximum_words > 1 ) {
+		fprintf( output_source, "const %s *opcode ) {\n", word_type());
+	}
+	else {
+		fprintf( output_source, "%s opcode ) {\n", word_type());
+	}
+}
+
+/*
+ *	Output the steps of an unrolled walk of the field layout table,
+ *	one for each level of the tree.  Each step is the same load,
+ *	mask, shift and add, so there is no branch to mispredict, and a
+ *	leaf (with a zero mask and jump) stays put for the steps left.
+ */
+static void emit_unrolled_walk( void ) {
+	const char	*op = ( maximum_words > 1 )? "opcode[ ptr->index ]": "opcode";
+
+	for( int i = 0; i < walk_steps; i++ ) {
+		fprintf( output_source, "\tptr += ptr->jump + (( %s & ptr->mask ) >> ptr->shift );\n", op );
+	}
+}
+
+/*
+ *	Output one step of the loop walking the table, testing the
+ *	opcode word 'op' against the row at ptr (whose mask is 'mask').
+ */
+static void emit_table_step( const char *op ) {
+	if( field_rows ) {
+		fprintf( output_source, "ptr += ptr->jump + (( %s & mask ) >> ptr->shift );\n", op );
+	}
+	else {
+		if( invert_tests ) {
+			fprintf( output_source, "ptr += (( %s & mask ) ^ ptr->flip )? ptr->jump: 1;\n", op );
+		}
+		else {
+			fprintf( output_source, "ptr += ( %s & mask )? ptr->jump: 1;\n", op );
+		}
+	}
+}
+
+/*
+ *	Output the routine which walks the table.  The table type is
+ *	expected to provide the members index (only when more than one
+ *	word is needed), mask, shift (in the field layout), flip (with
+ *	inverted tests) and jump.
+ */
+static void emit_table_find( void ) {
+	emit_comment( "Find the table row which decodes an opcode.", NULL );
+	emit_stdint();
+	emit_find_open();
+	fprintf( output_source, "\t%s\t*ptr;\n", data_type );
+	if( unroll_walk ) {
+		fprintf( output_source, "\n\tptr = %s;\n", data_name );
+		emit_unrolled_walk();
+	}
+	else {
+		fprintf( output_source, "\t%s\tmask;\n\n", word_type());
+		fprintf( output_source, "\tptr = %s;\n", data_name );
+		fprintf( output_source, "\twhile(( mask = ptr->mask )) " );
+		emit_table_step(( maximum_words > 1 )? "opcode[ ptr->index ]": "opcode" );
+	}
+	fprintf( output_source, "\treturn( ptr );\n" );
+	fprintf( output_source, "}\n\n" );
+}
+
+/*
+ *	Return the relative jump a table row holds.
+ */
+static int row_jump( NODE *node, int row ) {
+	if( node->leaf ) return( 0 );
+	return((( field_rows )? node->base: JUMP( node )->index ) - row );
+}
+
+/*
+ *	Output the literal type of a constexpr table row, holding the
+ *	members needed to walk the table (each in the narrowest type
+ *	which fits) and the leaf values as a member of the T type.
+ */
+static void emit_row_type( NODE **rows, int count ) {
+	int	low = 0,
+		high = 0;
+
+	for( int i = 0; i < count; i++ ) {
+		int j = row_jump( rows[ i ], i );
+
+		if( j < low ) low = j;
+		if( j > high ) high = j;
+	}
+	emit_stdint();
+	fprintf( output_source, "struct %s_row {\n", data_name );
+	if( maximum_words > 1 ) fprintf( output_source, "\t%s\tindex;\n", id_type( maximum_words - 1 ));
+	fprintf( output_source, "\t%s\tmask;\n", word_type());
+	if( field_rows ) fprintf( output_source, "\tuint8_t\tshift;\n" );
+	if( invert_tests ) fprintf( output_source, "\t%s\tflip;\n", word_type());
+	fprintf( output_source, "\t%s\tjump;\n",
+			(( low >= -0x80 )&&( high < 0x80 ))? "int8_t":
+			((( low >= -0x8000 )&&( high < 0x8000 ))? "int16_t": "int32_t" ));
+	fprintf( output_source, "\t%s\tvalue;\n", data_type );
+	fprintf( output_source, "};\n\n" );
+}
+
+/*
+ *	Output the constexpr routine which walks the table of rows,
+ *	one bit or one field at a time, returning the leaf values of
+ *	the row it stops at.
+ */
+static void emit_row_find( void ) {
+	const char	*op = ( maximum_words > 1 )? "opcode[ ptr->index ]": "opcode";
+
+	emit_comment( "Find the leaf which decodes an opcode.", NULL );
+	emit_find_open();
+	fprintf( output_source, "\tconst %s_row\t*ptr = &( %s[ 0 ]);\n", data_name, data_name );
+	if( unroll_walk ) {
+		fprintf( output_source, "\n" );
+		emit_unrolled_walk();
+		fprintf( output_source, "\treturn( &( ptr->value ));\n" );
+		fprintf( output_source, "}\n\n" );
+		return;
+	}
+	fprintf( output_source, "\t%s\tmask = 0;\n\n", word_type());
+	if( field_rows ) {
+		fprintf( output_source, "\twhile(( mask = ptr->mask )) ptr += ptr->jump + (( %s & mask ) >> ptr->shift );\n", op );
+	}
+	else {
+		if( invert_tests ) {
+			fprintf( output_source, "\twhile(( mask = ptr->mask )) ptr += (( %s & mask ) ^ ptr->flip )? ptr->jump: 1;\n", op );
+		}
+		else {
+			fprintf( output_source, "\twhile(( mask = ptr->mask )) ptr += ( %s & mask )? ptr->jump: 1;\n", op );
+		}
+	}
+	fprintf( output_source, "\treturn( &( ptr->value ));\n" );
+	fprintf( output_source, "}\n\n" );
+}
+
+/*
+ *	Follow the decode tree for an opcode returning the leaf
+ *	node that it finishes at.
+ */
+static NODE *find_leaf( NODE *node, word *opcode ) {
+	while( !node->leaf ) {
+		node = node->child[( opcode[ node->op_word ] >> node->op_bit ) & ((((word)1) << node->op_bits ) - 1 )];
+	}
+	return( node );
+}
+
+/*
+ *	Return the highest opcode word number tested in the tree.
+ */
+static int deepest_word( NODE *node ) {
+	int	d = 0;
+
+	if( !node->leaf ) {
+		d = node->op_word;
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) {
+			int c = deepest_word( node->child[ i ]);
+			if( c > d ) d = c;
+		}
+	}
+	return( d );
+}
+
+/*
+ *	Return the leaf number a leaf node represents, the error leaf
+ *	being number zero.
+ */
+static int leaf_id( NODE *node ) {
+	return(( node->decoded )? node->decoded->id: 0 );
+}
+
+/*
+ *	Output the array of leaf values, indexed by leaf number.  Entry
+ *	zero is the error handler, followed by each of the instructions
+ *	(in input order).
+ */
+static void emit_leaves( INSTRUCTION **leaf, int leaves ) {
+	emit_array_open( "", data_type, data_name, leaves, FALSE );
+	for( int i = 0; i < leaves; i++ ) {
+		char	sep = ( i < leaves-1 )?',':' ';
+
+		if(( i == 0 )&&( error_handler == NULL )) {
+			fprintf( output_source, "\t{ NULL" );
+			for( int j = 1; j < output_formats; j++ ) fprintf( output_source, ", NULL" );
+		}
+		else {
+			emit_values( "\t{ ", ( leaf[ i ])? leaf[ i ]->name: error_handler );
+		}
+		emit_leaf_comment( leaf[ i ], i, sep );
+	}
+	emit_array_close();
+	fprintf( output_source, "\n" );
+}
+
+/*
+ *	Return the name of the standard unsigned integer type of
+ *	the given number of bytes.
+ */
+static const char *sized_type( int bytes ) {
+	return(( bytes == 1 )? "uint8_t": (( bytes == 2 )? "uint16_t": "uint32_t" ));
+}
+
+/*
+ *	Output an array of numbers, sixteen to a line, each line
+ *	commented with the index of its first entry.
+ */
+static void emit_array( const char *suffix, const char *type, uint32_t *value, long count, bool aligned ) {
+	uint32_t	largest;
+	int		width,
+			digits;
+	char		*name = new_text( 1 );
+
+	largest = 0;
+	for( long i = 0; i < count; i++ ) if( value[ i ] > largest ) largest = value[ i ];
+	for( width = 1; largest >= 10; largest /= 10 ) width++;
+	for( digits = 1; ( count > 1 )&&(( count - 1 ) >> ( digits << 2 )); digits++ );
+	sprintf( name, "%s_%s", data_name, suffix );
+	emit_array_open( "const ", type, name, count, aligned );
+	for( long i = 0; i < count; i++ ) {
+		if(( i & 15 ) == 0 ) fprintf( output_source, "\t" );
+		fprintf( output_source, "%*u%c", width, (unsigned)value[ i ], ( i < count-1 )?',':' ' );
+		if((( i & 15 ) == 15 )||( i == count-1 )) {
+			fprintf( output_source, "\t%s 0x%0*lX %s\n", output_comment_a, digits, i & ~15L, output_comment_b );
+		}
+		else {
+			fprintf( output_source, " " );
+		}
+	}
+	emit_array_close();
+	fprintf( output_source, "\n" );
+	FREE( name );
+}
+
+/*
+ *	Gather the instructions found at the leaves of the tree
+ *	by their leaf numbers.
+ */
+static void collect_leaves( NODE *node, INSTRUCTION **leaf ) {
+	if( node->leaf ) {
+		leaf[ leaf_id( node )] = node->decoded;
+	}
+	else {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) collect_leaves( node->child[ i ], leaf );
+	}
+}
+
+/*
+ *	Output the decoder as a flat table giving the leaf number of
+ *	every possible opcode, followed by the leaf values themselves.
+ */
+static void emit_flat( NODE *tree, int count ) {
+	INSTRUCTION	**leaf;
+	uint32_t	*index;
+	word		opcode[ MAX_CODES ];
+	long		size;
+	int		leaves,
+			bytes;
+	char		note[ MAX_BUFFER ];
+
+	/*
+	 *	Decode every possible opcode.
+	 */
+	leaves = count + 1;
+	size = 1L << word_size;
+	index = (uint32_t *)malloc( sizeof( uint32_t ) * size );
+	for( int i = 0; i < MAX_CODES; opcode[ i++ ] = 0 );
+	for( long i = 0; i < size; i++ ) {
+		opcode[ 0 ] = (word)i;
+		index[ i ] = leaf_id( find_leaf( tree, opcode ));
+	}
+	/*
+	 *	Report what this is going to cost.
+	 */
+	bytes = ( leaves <= 0x100 )? 1: (( leaves <= 0x10000 )? 2: 4 );
+	sprintf( note, "Flat table of %ld entries of %d byte%s (%ld bytes) indexing %d leaves.",
+			size, bytes, ( bytes > 1 )? "s": "", size * bytes, leaves );
+	table_form = "flat";
+	table_entries = size;
+	table_entry_bytes = bytes;
+	table_bytes = size * bytes;
+	fprintf( stderr, "%s\n", note );
+	emit_comment( note, NULL );
+	emit_stdint();
+	emit_array( "index", id_type( leaves-1 ), index, size, FALSE );
+	FREE( index );
+	/*
+	 *	Now the leaf values and the routine to find them.
+	 */
+	leaf = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * leaves );
+	for( int i = 0; i < leaves; leaf[ i++ ] = NULL );
+	collect_leaves( tree, leaf );
+	emit_leaves( leaf, leaves );
+	emit_comment( "Find the leaf which decodes an opcode.", NULL );
+	emit_find_open();
+	fprintf( output_source, "\treturn( &( %s[ %s_index[ opcode ]]));\n", data_name, data_name );
+	fprintf( output_source, "}\n\n" );
+}
+
+/*
+ *	Sharing of identical subtrees.
+ *
+ *	Nodes are entered into a hash table by content so that any two
+ *	structurally identical subtrees end up as the same node.  A node
+ *	is only entered once all of its children have been.
+ */
+static NODE		**unique_table = NULL;
+static int		unique_size = 0,
+			unique_count = 0;
+
+/*
+ *	Hash the content of a node (its children being unique already).
+ */
+static uint32_t node_hash( NODE *node ) {
+	uint32_t	h;
+
+	if( node->leaf ) return((uint32_t)leaf_id( node ) * 0x9E3779B1 );
+	h = ((uint32_t)node->op_word << 16 )^((uint32_t)node->op_bit << 8 )^(uint32_t)node->op_bits;
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) h = ( h ^ (uint32_t)(uintptr_t)node->child[ i ]) * 0x01000193;
+	return( h );
+}
+
+/*
+ *	Are two nodes (with unique children) the same?
+ */
+static bool node_same( NODE *a, NODE *b ) {
+	if( a->leaf || b->leaf ) return( a->leaf && b->leaf &&( a->decoded == b->decoded ));
+	if(( a->op_word != b->op_word )||( a->op_bit != b->op_bit )||( a->op_bits != b->op_bits )) return( FALSE );
+	for( int i = 0; i < ( 1 << a->op_bits ); i++ ) if( a->child[ i ] != b->child[ i ]) return( FALSE );
+	return( TRUE );
+}
+
+/*
+ *	Return the unique node matching this one, entering it into the
+ *	table if it is the first of its kind.
+ */
+static NODE *unique( NODE *node ) {
+	uint32_t	h;
+	NODE		*n;
+
+	if( unique_count * 2 >= unique_size ) {
+		NODE	**old = unique_table;
+		int	size = unique_size;
+
+		unique_size = ( size )? size << 1: 1024;
+		unique_table = (NODE **)malloc( sizeof( NODE * ) * unique_size );
+		for( int i = 0; i < unique_size; unique_table[ i++ ] = NULL );
+		for( int i = 0; i < size; i++ ) {
+			if(( n = old[ i ])) {
+				h = node_hash( n ) & ( unique_size - 1 );
+				while( unique_table[ h ]) h = ( h + 1 ) & ( unique_size - 1 );
+				unique_table[ h ] = n;
+			}
+		}
+		if( old ) FREE( old );
+	}
+	h = node_hash( node ) & ( unique_size - 1 );
+	while(( n = unique_table[ h ])) {
+		if( node_same( n, node )) return( n );
+		h = ( h + 1 ) & ( unique_size - 1 );
+	}
+	unique_table[ h ] = node;
+	unique_count++;
+	return( node );
+}
+
+/*
+ *	Turn the tree into a graph where every distinct subtree
+ *	appears only once.
+ */
+static NODE *share( NODE *node ) {
+	if( !node->leaf ) {
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) node->child[ i ] = share( node->child[ i ]);
+	}
+	return( unique( node ));
+}
+
+/*
+ *	Multi-level trie construction.
+ *
+ *	The opcode is cut into levels, the top bits first.  Each level
+ *	is an array of pages with one entry per value of that level's
+ *	bits.  An entry is either a leaf number (flagged with TRIE_LEAF)
+ *	or the offset of a page in the next level.  Pages are shared
+ *	whenever their content is identical.
+ *
+ *	Each page is made from a (shared) tree which only tests the bits
+ *	of its level and below.  Fixing the bits of the level reduces
+ *	that tree to what is left to be tested by the levels below, and
+ *	since the reduced trees are shared too, the same page is never
+ *	worked out twice.
+ */
+#define TRIE_LEAF	0x80000000
+
+typedef struct {
+	int		bits,			/* The width of this level			*/
+			shift,			/* Bit number of the lowest bit in it		*/
+			pages,			/* How many unique pages are used		*/
+			space;			/* How many pages there is room for		*/
+	uint32_t	*entry,			/* The pages of the level			*/
+			*work;			/* One page being assembled			*/
+	double		*loads;			/* Expected loads from each page		*/
+	int		*seen,			/* Hash table of pages by content		*/
+			seen_size;
+} TRIE_LEVEL;
+
+typedef struct {
+	int		level;
+	NODE		*node;
+	uint32_t	offset;
+} TRIE_STATE;
+
+static int		trie_levels = 0;
+static TRIE_LEVEL	trie_level[ MAX_LEVELS ];
+static TRIE_STATE	*trie_state = NULL;
+static int		trie_states = 0,
+			trie_state_size = 0;
+
+/*
+ *	Simple hashing of a block of 32 bit values.
+ */
+static uint32_t trie_hash( uint32_t *data, int count, uint32_t h ) {
+	for( int i = 0; i < count; i++ ) h = ( h ^ data[ i ]) * 0x01000193;
+	return( h );
+}
+
+/*
+ *	Empty the trie ready for levels of the widths given.
+ */
+static void trie_reset( int levels, int *width ) {
+	int	shift = word_size;
+
+	for( int l = 0; l < trie_levels; l++ ) {
+		FREE( trie_level[ l ].entry );
+		FREE( trie_level[ l ].work );
+		FREE( trie_level[ l ].loads );
+		FREE( trie_level[ l ].seen );
+	}
+	trie_levels = levels;
+	for( int l = 0; l < levels; l++ ) {
+		TRIE_LEVEL *p = &( trie_level[ l ]);
+
+		shift -= width[ l ];
+		p->bits = width[ l ];
+		p->shift = shift;
+		p->pages = 0;
+		p->space = 16;
+		p->entry = (uint32_t *)malloc( sizeof( uint32_t ) * ( p->space << p->bits ));
+		p->work = (uint32_t *)malloc( sizeof( uint32_t ) << p->bits );
+		p->loads = (double *)malloc( sizeof( double ) * p->space );
+		p->seen_size = 64;
+		p->seen = (int *)malloc( sizeof( int ) * p->seen_size );
+		for( int i = 0; i < p->seen_size; p->seen[ i++ ] = -1 );
+	}
+	trie_states = 0;
+	if( trie_state == NULL ) {
+		trie_state_size = 1024;
+		trie_state = (TRIE_STATE *)malloc( sizeof( TRIE_STATE ) * trie_state_size );
+	}
+	for( int i = 0; i < trie_state_size; trie_state[ i++ ].node = NULL );
+}
+
+/*
+ *	Return the slot in the state table for a tree at a level.
+ */
+static TRIE_STATE *trie_find_state( int level, NODE *node ) {
+	uint32_t	h;
+	TRIE_STATE	*s;
+
+	h = (((uint32_t)level * 0x9E3779B1 ) ^ (uint32_t)(uintptr_t)node ) & ( trie_state_size - 1 );
+	while(( s = &( trie_state[ h ]))->node ) {
+		if(( s->level == level )&&( s->node == node )) break;
+		h = ( h + 1 ) & ( trie_state_size - 1 );
+	}
+	return( s );
+}
+
+/*
+ *	Reduce a (shared) tree by fixing the value of the bits of a
+ *	level, returning the shared tree of what is left to test.  A
+ *	field running below the level is cut down to its lower part.
+ */
+static NODE *trie_reduce( NODE *node, TRIE_LEVEL *p, word value ) {
+	word	level = field_mask( p->shift, p->bits ),
+		field;
+	NODE	*here;
+	int	n;
+
+	if( node->leaf ) return( node );
+	field = field_mask( node->op_bit, node->op_bits );
+	if(( field & ~level ) == 0 ) {
+		/*
+		 *	Decided entirely by this level.
+		 */
+		return( trie_reduce( node->child[( value >> node->op_bit ) & ((((word)1) << node->op_bits ) - 1 )], p, value ));
+	}
+	if( field & level ) {
+		/*
+		 *	Top of the field is in this level, keep
+		 *	the branches that match it.
+		 */
+		int top;
+
+		n = p->shift - node->op_bit;
+		top = ( value >> p->shift ) & (( 1 << ( node->op_bits - n )) - 1 );
+		here = new_node( NULL, node->op_word, node->op_bit, n );
+		for( int i = 0; i < ( 1 << n ); i++ ) here->child[ i ] = trie_reduce( node->child[( top << n ) | i ], p, value );
+	}
+	else {
+		/*
+		 *	Nothing tested here is in this level.
+		 */
+		here = new_node( NULL, node->op_word, node->op_bit, node->op_bits );
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) here->child[ i ] = trie_reduce( node->child[ i ], p, value );
+	}
+	/*
+	 *	Most reductions have been seen before, so only keep the
+	 *	new node if it really is new.
+	 */
+	if(( node = unique( here )) != here ) free_node( here );
+	return( node );
+}
+
+/*
+ *	Return the offset of the page (in level l) which carries on the
+ *	decode using the (shared) tree given.
+ */
+static uint32_t trie_page( int l, NODE *node ) {
+	TRIE_LEVEL	*p = &( trie_level[ l ]);
+	TRIE_STATE	*s;
+	uint32_t	h;
+	int		size = 1 << p->bits,
+			page;
+	double		loads;
+
+	/*
+	 *	Seen this tree before?
+	 */
+	if(( s = trie_find_state( l, node ))->node ) return( s->offset );
+	/*
+	 *	Fill in the page.
+	 */
+	loads = 1.0;
+	for( int v = 0; v < size; v++ ) {
+		NODE	*n = trie_reduce( node, p, (word)v << p->shift );
+
+		if( n->leaf ) {
+			p->work[ v ] = TRIE_LEAF | leaf_id( n );
+		}
+		else {
+			uint32_t o = trie_page( l+1, n );
+
+			p->work[ v ] = o;
+			loads += trie_level[ l+1 ].loads[ o >> trie_level[ l+1 ].bits ] / size;
+		}
+	}
+	/*
+	 *	Is this page already in the level?
+	 */
+	h = trie_hash( p->work, size, 0x811C9DC5 ) & ( p->seen_size - 1 );
+	while(( page = p->seen[ h ]) >= 0 ) {
+		if( memcmp( p->entry + ((long)page << p->bits ), p->work, sizeof( uint32_t ) << p->bits ) == 0 ) break;
+		h = ( h + 1 ) & ( p->seen_size - 1 );
+	}
+	if( page < 0 ) {
+		/*
+		 *	No, so add it.
+		 */
+		if( p->pages == p->space ) {
+			p->space <<= 1;
+			p->entry = (uint32_t *)realloc( p->entry, sizeof( uint32_t ) * ((long)p->space << p->bits ));
+			p->loads = (double *)realloc( p->loads, sizeof( double ) * p->space );
+		}
+		page = p->pages++;
+		memcpy( p->entry + ((long)page << p->bits ), p->work, sizeof( uint32_t ) << p->bits );
+		p->loads[ page ] = loads;
+		p->seen[ h ] = page;
+		if( p->pages * 2 > p->seen_size ) {
+			/*
+			 *	Time to grow the hash table.
+			 */
+			FREE( p->seen );
+			p->seen_size <<= 1;
+			p->seen = (int *)malloc( sizeof( int ) * p->seen_size );
+			for( int i = 0; i < p->seen_size; p->seen[ i++ ] = -1 );
+			for( int i = 0; i < p->pages; i++ ) {
+				h = trie_hash( p->entry + ((long)i << p->bits ), size, 0x811C9DC5 ) & ( p->seen_size - 1 );
+				while( p->seen[ h ] >= 0 ) h = ( h + 1 ) & ( p->seen_size - 1 );
+				p->seen[ h ] = i;
+			}
+		}
+	}
+	/*
+	 *	Remember the state (making room if needed; finding the
+	 *	slot again as the recursion above may have moved it).
+	 */
+	if( trie_states * 2 >= trie_state_size ) {
+		TRIE_STATE	*old = trie_state;
+		int		size = trie_state_size;
+
+		trie_state_size <<= 1;
+		trie_state = (TRIE_STATE *)malloc( sizeof( TRIE_STATE ) * trie_state_size );
+		for( int i = 0; i < trie_state_size; trie_state[ i++ ].node = NULL );
+		for( int i = 0; i < size; i++ ) {
+			if( old[ i ].node ) *trie_find_state( old[ i ].level, old[ i ].node ) = old[ i ];
+		}
+		FREE( old );
+	}
+	s = trie_find_state( l, node );
+	s->level = l;
+	s->node = node;
+	s->offset = (uint32_t)page << p->bits;
+	trie_states++;
+	return( s->offset );
+}
+
+/*
+ *	Return the number of bytes each entry of a trie level needs.
+ */
+static int trie_entry_bytes( int l, int leaves ) {
+	uint32_t	largest = leaves - 1;
+
+	if( l < trie_levels-1 ) {
+		uint32_t next = (uint32_t)( trie_level[ l+1 ].pages - 1 ) << trie_level[ l+1 ].bits;
+
+		if( next > largest ) largest = next;
+		/*
+		 *	Leave room for the leaf flag.
+		 */
+		largest = ( largest << 1 ) | 1;
+	}
+	return(( largest <= 0xFF )? 1: (( largest <= 0xFFFF )? 2: 4 ));
+}
+
+/*
+ *	Build the trie for the level widths given, returning the total
+ *	size of its arrays in bytes and the expected number of loads
+ *	(including the leaf values) for an opcode picked at random.
+ */
+static long build_trie( NODE *tree, int leaves, int levels, int *width, double *loads ) {
+	long	bytes;
+
+	trie_reset( levels, width );
+	(void)trie_page( 0, tree );
+	*loads = trie_level[ 0 ].loads[ 0 ] + 1.0;
+	bytes = 0;
+	for( int l = 0; l < levels; l++ ) bytes += ((long)trie_level[ l ].pages << trie_level[ l ].bits ) * trie_entry_bytes( l, leaves );
+	return( bytes );
+}
+
+/*
+ *	Describe a set of level widths.
+ */
+static char *trie_split( char *buffer, int levels, int *width ) {
+	char	*p = buffer;
+
+	for( int l = 0; l < levels; l++ ) p += sprintf( p, "%s%d", ( l )? "/": "", width[ l ]);
+	return( buffer );
+}
+
+/*
+ *	Output the decoder as a multi-level trie, picking the level widths
+ *	which give the smallest arrays (or the fewest loads) unless they
+ *	have been given.
+ */
+static void emit_trie( NODE *tree, int count ) {
+	INSTRUCTION	**leaf;
+	int		leaves,
+			width[ MAX_LEVELS ],
+			best_width[ MAX_LEVELS ][ 2 ],
+			best_levels[ 2 ],
+			levels,
+			pick;
+	long		bytes,
+			best_bytes[ 2 ];
+	double		loads,
+			best_loads[ 2 ];
+	char		split[ MAX_BUFFER ],
+			note[ MAX_BUFFER ];
+
+	leaves = count + 1;
+	tree = share( tree );
+	if( trie_given ) {
+		/*
+		 *	The split points have been specified.
+		 */
+		levels = trie_given;
+		for( int l = 0; l < levels; l++ ) width[ l ] = trie_width[ l ];
+		pick = trie_objective;
+	}
+	else {
+		/*
+		 *	Try every way of splitting the word into levels no wider
+		 *	than MAX_PAGE bits, keeping the best by size ([0]) and by
+		 *	expected loads ([1]).  For the wider word sizes only
+		 *	levels a multiple of four bits wide are tried.
+		 */
+		int	step = ( word_size > WARN_FLAT )? 4: 1;
+
+		best_levels[ 0 ] = best_levels[ 1 ] = 0;
+		for( levels = 1; levels <= MAX_LEVELS; levels++ ) {
+			for( int l = 0; l < levels; width[ l++ ] = step );
+			while( TRUE ) {
+				int	total = 0;
+
+				for( int l = 0; l < levels; l++ ) total += width[ l ];
+				if( total == word_size ) {
+					bytes = build_trie( tree, leaves, levels, width, &loads );
+					for( int o = 0; o < 2; o++ ) {
+						bool better;
+
+						if( best_levels[ o ] == 0 ) {
+							better = TRUE;
+						}
+						else {
+							if( o == 0 ) {
+								better = ( bytes < best_bytes[ o ])||(( bytes == best_bytes[ o ])&&( loads < best_loads[ o ]));
+							}
+							else {
+								better = ( loads < best_loads[ o ])||(( loads == best_loads[ o ])&&( bytes < best_bytes[ o ]));
+							}
+						}
+						if( better ) {
+							best_levels[ o ] = levels;
+							best_bytes[ o ] = bytes;
+							best_loads[ o ] = loads;
+							for( int l = 0; l < levels; l++ ) best_width[ l ][ o ] = width[ l ];
+						}
+					}
+				}
+				/*
+				 *	Next combination of widths.
+				 */
+				int l = levels-1;
+				while(( l >= 0 )&&( width[ l ] + step > MAX_PAGE )) width[ l-- ] = step;
+				if( l < 0 ) break;
+				width[ l ] += step;
+			}
+		}
+		if( best_levels[ 0 ] == 0 ) {
+			fprintf( stderr, "No trie levels fit word size %d.\n", word_size );
+			dropped++;
+			return;
+		}
+		for( int o = 0; o < 2; o++ ) {
+			for( int l = 0; l < best_levels[ o ]; l++ ) width[ l ] = best_width[ l ][ o ];
+			fprintf( stderr, "Smallest %s trie: levels %s, %ld bytes, %.3f expected loads.\n",
+					( o == 0 )? "size": "loads",
+					trie_split( split, best_levels[ o ], width ),
+					best_bytes[ o ], best_loads[ o ]);
+		}
+		pick = trie_objective;
+		levels = best_levels[ pick ];
+		for( int l = 0; l < levels; l++ ) width[ l ] = best_width[ l ][ pick ];
+	}
+	/*
+	 *	Rebuild the one we want and output it.
+	 */
+	bytes = build_trie( tree, leaves, levels, width, &loads );
+	sprintf( note, "Trie of levels %s: %ld bytes, %.3f expected loads, %d leaves.",
+			trie_split( split, levels, width ), bytes, loads, leaves );
+	table_form = "trie";
+	table_bytes = bytes;
+	fprintf( stderr, "%s\n", note );
+	emit_comment( note, NULL );
+	emit_stdint();
+	for( int l = 0; l < levels; l++ ) {
+		TRIE_LEVEL	*p = &( trie_level[ l ]);
+		long		size = (long)p->pages << p->bits;
+		int		b = trie_entry_bytes( l, leaves );
+		uint32_t	flag = (uint32_t)1 << (( b << 3 ) - 1 );
+		char		name[ 16 ];
+
+		/*
+		 *	Move the leaf flag down to the top bit of the type
+		 *	used by this level.
+		 */
+		if( l < levels-1 ) {
+			for( long i = 0; i < size; i++ ) if( p->entry[ i ] & TRIE_LEAF ) p->entry[ i ] = ( p->entry[ i ] & ~TRIE_LEAF ) | flag;
+		}
+		else {
+			for( long i = 0; i < size; i++ ) p->entry[ i ] &= ~TRIE_LEAF;
+		}
+		sprintf( name, "level%d", l+1 );
+		emit_array( name, sized_type( b ), p->entry, size, FALSE );
+	}
+	leaf = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * leaves );
+	for( int i = 0; i < leaves; leaf[ i++ ] = NULL );
+	collect_leaves( tree, leaf );
+	emit_leaves( leaf, leaves );
+	/*
+	 *	The lookup routine is one step per level, stopping as soon
+	 *	as a leaf is found.
+	 */
+	emit_comment( "Find the leaf which decodes an opcode.", NULL );
+	emit_find_open();
+	if( levels > 1 ) fprintf( output_source, ( constexpr_output )? "\tuint32_t\te = 0;\n\n": "\tuint32_t\te;\n\n" );
+	for( int l = 0; l < levels; l++ ) {
+		TRIE_LEVEL	*p = &( trie_level[ l ]);
+		char		index[ MAX_BUFFER ];
+
+		if( l == 0 ) {
+			sprintf( index, "opcode >> %d", p->shift );
+		}
+		else {
+			if( p->shift ) {
+				sprintf( index, "e + (( opcode >> %d ) & 0x%X )", p->shift, ( 1 << p->bits ) - 1 );
+			}
+			else {
+				sprintf( index, "e + ( opcode & 0x%X )", ( 1 << p->bits ) - 1 );
+			}
+		}
+		if( l < levels-1 ) {
+			uint32_t flag = (uint32_t)1 << (( trie_entry_bytes( l, leaves ) << 3 ) - 1 );
+
+			fprintf( output_source, "\tif(( e = %s_level%d[ %s ]) & 0x%X ) return( &( %s[ e & 0x%X ]));\n",
+					data_name, l+1, index, flag, data_name, flag - 1 );
+		}
+		else {
+			fprintf( output_source, "\treturn( &( %s[ %s_level%d[ %s ]]));\n", data_name, data_name, l+1, index );
+		}
+	}
+	fprintf( output_source, "}\n\n" );
+}
+
+/*
+ *	Output a number of tabs.
+ */
+static void emit_indent( int depth ) {
+	while( depth-- ) fputc( TAB, output_source );
+}
+
+/*
+ *	Output the expression giving opcode word w.
+ */
+static void emit_opcode( int w ) {
+	if( maximum_words > 1 ) {
+		fprintf( output_source, "opcode[ %d ]", w );
+	}
+	else {
+		fprintf( output_source, "opcode" );
+	}
+}
+
+/*
+ *	Output the statement returning a leaf, commented with the name
+ *	of the instruction.
+ */
+static void emit_return( NODE *node ) {
+	const char *name = ( node->decoded )? node->decoded->name: error_handler;
+
+	fprintf( output_source, "return( &( %s[ %d ]));", data_name, leaf_id( node ));
+	if( name ) fprintf( output_source, "\t%s %s %s", output_comment_a, name, output_comment_b );
+	fprintf( output_source, "\n" );
+}
+
+/*
+ *	Output the statements for the branch of a node, either a
+ *	return on the same line or a block of code.
+ */
+static void emit_code_node( NODE *node, int depth );
+static void emit_branch( NODE *node, int depth ) {
+	if( node->leaf ) {
+		emit_return( node );
+	}
+	else {
+		fprintf( output_source, "{\n" );
+		emit_code_node( node, depth+1 );
+		emit_indent( depth );
+		fprintf( output_source, "}\n" );
+	}
+}
+
+/*
+ *	Output the code deciding a subtree.
+ *
+ *	A one bit node becomes an if statement for the one branch
+ *	followed by the code of the zero branch (every branch ends
+ *	in a return).  A field node becomes a switch statement on the
+ *	value of the field, where values leading to the same (shared)
+ *	subtree share one case and the subtree reached by the most
+ *	values becomes the default.
+ */
+static void emit_code_node( NODE *node, int depth ) {
+	if( node->leaf ) {
+		emit_indent( depth );
+		emit_return( node );
+		return;
+	}
+	if( node->op_bits == 1 ) {
+		emit_indent( depth );
+		fprintf( output_source, "if( " );
+		emit_opcode( node->op_word );
+		fprintf( output_source, " & 0x%0*" PRIX64 " ) ", ( word_size + 3 ) >> 2, (uint64_t)field_mask( node->op_bit, 1 ));
+		emit_branch( ONE( node ), depth );
+		emit_code_node( ZERO( node ), depth );
+	}
+	else {
+		int	size = 1 << node->op_bits,
+			most = 0;
+		NODE	*common = NULL;
+
+		for( int i = 0; i < size; i++ ) {
+			int	used = 0;
+
+			for( int j = i; j < size; j++ ) if( node->child[ j ] == node->child[ i ]) used++;
+			if( used > most ) {
+				most = used;
+				common = node->child[ i ];
+			}
+		}
+		emit_indent( depth );
+		if( node->op_bit ) {
+			fprintf( output_source, "switch(( " );
+			emit_opcode( node->op_word );
+			fprintf( output_source, " >> %d ) & 0x%X ) {\n", node->op_bit, size - 1 );
+		}
+		else {
+			fprintf( output_source, "switch( " );
+			emit_opcode( node->op_word );
+			fprintf( output_source, " & 0x%X ) {\n", size - 1 );
+		}
+		for( int i = 0; i < size; i++ ) {
+			NODE	*branch = node->child[ i ];
+			bool	first = TRUE;
+
+			/*
+			 *	Skip the default and values already covered.
+			 */
+			if( branch == common ) continue;
+			for( int j = 0; j < i; j++ ) if( node->child[ j ] == branch ) first = FALSE;
+			if( !first ) continue;
+			for( int j = i; j < size; j++ ) {
+				if( node->child[ j ] == branch ) {
+					if( j > i ) fprintf( output_source, "\n" );
+					emit_indent( depth+1 );
+					fprintf( output_source, "case 0x%X:", j );
+				}
+			}
+			fprintf( output_source, " " );
+			emit_branch( branch, depth+1 );
+		}
+		emit_indent( depth+1 );
+		fprintf( output_source, "default: " );
+		emit_branch( common, depth+1 );
+		emit_indent( depth );
+		fprintf( output_source, "}\n" );
+	}
+}
+
+/*
+ *	Count the if statements (single set) or the switch statements
+ *	the code for a subtree is made of.
+ */
+static int count_tests( NODE *node, bool single ) {
+	int	n;
+
+	if( node->leaf ) return( 0 );
+	n = (( node->op_bits == 1 ) == single );
+	for( int i = 0; i < ( 1 << node->op_bits ); i++ ) {
+		bool	first = TRUE;
+
+		for( int j = 0; j < i; j++ ) if( node->child[ j ] == node->child[ i ]) first = FALSE;
+		if( first ) n += count_tests( node->child[ i ], single );
+	}
+	return( n );
+}
+
+/*
+ *	Output the decoder as the code of the find routine, followed
+ *	by the leaf values it returns.
+ */
+static void emit_code( NODE *tree, int count ) {
+	INSTRUCTION	**leaf;
+	int		leaves;
+	char		note[ MAX_BUFFER ];
+
+	leaves = count + 1;
+	tree = share( tree );
+	sprintf( note, "Decoder code of %d tests (%d ifs and %d switches) returning %d leaves.",
+			count_tests( tree, TRUE ) + count_tests( tree, FALSE ),
+			count_tests( tree, TRUE ), count_tests( tree, FALSE ), leaves );
+	table_form = "code";
+	table_entries = count_tests( tree, TRUE ) + count_tests( tree, FALSE );
+	fprintf( stderr, "%s\n", note );
+	emit_comment( note, NULL );
+	emit_stdint();
+	leaf = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * leaves );
+	for( int i = 0; i < leaves; leaf[ i++ ] = NULL );
+	collect_leaves( tree, leaf );
+	emit_leaves( leaf, leaves );
+	FREE( leaf );
+	emit_comment( "Find the leaf which decodes an opcode.", NULL );
+	emit_find_open();
+	emit_code_node( tree, 1 );
+	fprintf( output_source, "}\n\n" );
+}
+
+/*
+ *	Packed table output.
+ *
+ *	Each row of the table becomes a single 16 or 32 bit entry.  A
+ *	leaf entry has the top bit set with the leaf number below it.
+ *	A decision entry holds, from the bottom up, the number of the
+ *	(lowest) bit tested, the opcode word (when there is more than
+ *	one), the field width less one (with field nodes) and the jump.
+ *
+ *	A jump which is negative or too long for its field is "far":
+ *	the jump field then holds the position of the real jump in a
+ *	separate array of 32 bit jumps, offset by the first far value.
+ */
+/*
+ *	Count the jumps in the table which are not from 0 to near-1.
+ */
+static int far_jumps( NODE **rows, int count, int near ) {
+	int	far = 0;
+
+	for( int i = 0; i < count; i++ ) {
+		if( !rows[ i ]->leaf ) {
+			int j = row_jump( rows[ i ], i );
+
+			if(( j < 0 )||( j >= near )) far++;
+		}
+	}
+	return( far );
+}
+
+/*
+ *	Work out how the jumps of the table fit into entries of the
+ *	given number of bits, returning the number of near jump values
+ *	(or 0 if the table will not fit) and the far jumps needed.
+ */
+static int pack_jumps( NODE **rows, int count, int leaves, int bits, int *far ) {
+	int	jump_bits,
+		codes,
+		near;
+
+	jump_bits = bits - 1 - bits_needed( word_size );
+	if( maximum_words > 1 ) jump_bits -= bits_needed( maximum_words );
+	if( field_rows ) jump_bits -= bits_needed( field_bits );
+	if(( jump_bits < 1 )||( leaves > ( 1L << ( bits - 1 )))) return( 0 );
+	/*
+	 *	Every far jump takes a value away from the near jumps,
+	 *	which can make more jumps far.
+	 */
+	codes = 1 << jump_bits;
+	near = codes;
+	while(( near > 0 )&&( near + ( *far = far_jumps( rows, count, near )) > codes )) near = codes - *far;
+	return(( near > 0 )? near: 0 );
+}
+
+/*
+ *	Output the table as packed entries, followed by the leaf values
+ *	and the routine walking the entries.
+ */
+static void emit_packed( NODE **rows, int count, int instructions ) {
+	INSTRUCTION	**leaf;
+	uint32_t	*entry;
+	int32_t		*far_jump;
+	int		leaves,
+			bits,
+			near,
+			far,
+			next,
+			word_shift,
+			width_shift,
+			jump_shift;
+	const char	*op;
+	char		buffer[ MAX_BUFFER ],
+			jump[ MAX_BUFFER ],
+			note[ MAX_BUFFER ];
+
+	leaves = instructions + 1;
+	if( packed_bits ) {
+		/*
+		 *	The size has been given, so take any far jumps needed.
+		 */
+		bits = packed_bits;
+		near = pack_jumps( rows, count, leaves, bits, &far );
+	}
+	else {
+		/*
+		 *	Use the smallest entries needing no far jumps, if
+		 *	there are any, otherwise the smallest that fit.
+		 */
+		near = 0;
+		for( bits = 16; bits <= 32; bits += 16 ) if(( near = pack_jumps( rows, count, leaves, bits, &far ))&&( far == 0 )) break;
+		if( bits > 32 ) {
+			for( bits = 16; bits <= 32; bits += 16 ) if(( near = pack_jumps( rows, count, leaves, bits, &far ))) break;
+		}
+	}
+	if( near == 0 ) {
+		fprintf( stderr, "Table will not pack into %d bit entries.\n", ( packed_bits )? packed_bits: 32 );
+		dropped++;
+		return;
+	}
+	word_shift = bits_needed( word_size );
+	width_shift = word_shift + (( maximum_words > 1 )? bits_needed( maximum_words ): 0 );
+	jump_shift = width_shift + (( field_rows )? bits_needed( field_bits ): 0 );
+	/*
+	 *	Fill in the entries.
+	 */
+	entry = (uint32_t *)malloc( sizeof( uint32_t ) * count );
+	far_jump = (int32_t *)malloc( sizeof( int32_t ) * ( far + 1 ));
+	next = 0;
+	for( int i = 0; i < count; i++ ) {
+		NODE	*node = rows[ i ];
+
+		if( node->leaf ) {
+			entry[ i ] = ((uint32_t)1 << ( bits - 1 )) | (uint32_t)leaf_id( node );
+		}
+		else {
+			int j = row_jump( node, i );
+
+			if(( j < 0 )||( j >= near )) {
+				far_jump[ next ] = j;
+				j = near + next++;
+			}
+			entry[ i ] = (uint32_t)node->op_bit
+					| ((uint32_t)node->op_word << word_shift )
+					| ((uint32_t)( node->op_bits - 1 ) << width_shift )
+					| ((uint32_t)j << jump_shift );
+		}
+	}
+	sprintf( note, "Packed table of %d entries of %d bits (%d bytes), %d far jump%s, indexing %d leaves.",
+			count, bits, count * ( bits >> 3 ), far, ( far == 1 )? "": "s", leaves );
+	table_form = "packed";
+	table_entries = count;
+	table_entry_bytes = bits >> 3;
+	table_bytes = count * ( bits >> 3 ) + far * 4;
+	fprintf( stderr, "%s\n", note );
+	emit_comment( note, NULL );
+	emit_stdint();
+	emit_array( "table", sized_type( bits >> 3 ), entry, count, align_table );
+	FREE( entry );
+	if( far ) {
+		char	*name = new_text( 1 );
+
+		sprintf( name, "%s_far", data_name );
+		emit_array_open( "const ", "int32_t", name, far, FALSE );
+		for( int i = 0; i < far; i++ ) fprintf( output_source, "\t%d%c\n", (int)far_jump[ i ], ( i < far-1 )? ',': ' ' );
+		emit_array_close();
+		fprintf( output_source, "\n" );
+		FREE( name );
+	}
+	FREE( far_jump );
+	/*
+	 *	Now the leaf values.
+	 */
+	leaf = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * leaves );
+	for( int i = 0; i < leaves; leaf[ i++ ] = NULL );
+	for( int i = 0; i < count; i++ ) if( rows[ i ]->leaf ) leaf[ leaf_id( rows[ i ])] = rows[ i ]->decoded;
+	emit_leaves( leaf, leaves );
+	FREE( leaf );
+	/*
+	 *	The routine unpacks each entry as it goes.
+	 */
+	if( maximum_words > 1 ) {
+		sprintf( buffer, "opcode[ ( e >> %d ) & 0x%X ]", word_shift, ( 1 << bits_needed( maximum_words )) - 1 );
+		op = buffer;
+	}
+	else {
+		op = "opcode";
+	}
+	emit_comment( "Find the leaf which decodes an opcode.", NULL );
+	emit_find_open();
+	fprintf( output_source, "\tconst %s\t*ptr = &( %s_table[ 0 ]);\n", sized_type( bits >> 3 ), data_name );
+	fprintf( output_source, "\tuint32_t\te = *ptr;\n\n" );
+	fprintf( output_source, "\twhile( !( e & 0x%lX )) {\n", 1UL << ( bits - 1 ));
+	if( far ) {
+		fprintf( output_source, "\t\tint32_t\tj = (int32_t)( e >> %d );\n\n", jump_shift );
+		fprintf( output_source, "\t\tif( j >= %d ) j = %s_far[ j - %d ];\n", near, data_name, near );
+		strcpy( jump, "j" );
+	}
+	else {
+		sprintf( jump, "( e >> %d )", jump_shift );
+	}
+	if( field_rows ) {
+		fprintf( output_source, "\t\tptr += %s + (( %s >> ( e & 0x%X )) & (( 2 << (( e >> %d ) & 0x%X )) - 1 ));\n",
+				jump, op, ( 1 << word_shift ) - 1, width_shift, ( 1 << bits_needed( field_bits )) - 1 );
+	}
+	else {
+		fprintf( output_source, "\t\tptr += (( %s >> ( e & 0x%X )) & 1 )? %s: 1;\n", op, ( 1 << word_shift ) - 1, jump );
+	}
+	fprintf( output_source, "\t\te = *ptr;\n" );
+	fprintf( output_source, "\t}\n" );
+	fprintf( output_source, "\treturn( &( %s[ e & 0x%lX ]));\n", data_name, ( 1UL << ( bits - 1 )) - 1 );
+	fprintf( output_source, "}\n\n" );
+}
+
+/*
+ *	Structure of arrays output.
+ *
+ *	Only the decision nodes of the (shared) tree are output, each
+ *	spread across arrays of the bit tested (N_bit), the opcode word
+ *	(N_word, when W > 1) and, for field nodes, the field mask and
+ *	the start of its children (N_mask and N_base).  The children of
+ *	every node are found in N_child, either a node number or (with
+ *	the top bit set) a leaf number.  One bit nodes have their two
+ *	children at twice their node number.  The values of each F
+ *	record are a separate array indexed by leaf number, and the
+ *	leaf numbers are given names by an enum.
+ */
+
+/*
+ *	Number the decision nodes of a (shared) tree, once each, in
+ *	the order they are first reached.
+ */
+static int number_nodes( NODE *node, NODE **nodes, int count ) {
+	if(( !node->leaf )&&( node->index < 0 )) {
+		nodes[ count ] = node;
+		node->index = count++;
+		for( int i = 0; i < ( 1 << node->op_bits ); i++ ) count = number_nodes( node->child[ i ], nodes, count );
+	}
+	return( count );
+}
+
+/*
+ *	Fill in the name of the enum value for a leaf, the upper case
+ *	name of the instruction (or error handler) with anything which
+ *	cannot be in an identifier replaced by an underscore.
+ */
+static void leaf_enum( char *buffer, INSTRUCTION *ptr ) {
+	const char	*name = ( ptr )? ptr->name: (( error_handler )? error_handler: "invalid" );
+	char		*p;
+
+	sprintf( buffer, "%s_%s", data_name, name );
+	for( p = buffer; *p; p++ ) *p = isalnum( *p )? toupper( *p ): '_';
+}
+
+/*
+ *	Output (once) the array N_words[] of the length in words of the
+ *	instruction found at each table row (given the rows) or else at
+ *	each leaf number.
+ */
+static void emit_words( NODE **rows, int size, INSTRUCTION **order, int count ) {
+	uint32_t	*words;
+
+	if( words_output ) return;
+	words_output = TRUE;
+	if( rows == NULL ) size = count + 1;
+	words = (uint32_t *)malloc( sizeof( uint32_t ) * size );
+	for( int i = 0; i < size; i++ ) {
+		if( rows ) {
+			words[ i ] = ( !rows[ i ]->leaf )? 0: (( rows[ i ]->decoded )? rows[ i ]->decoded->elements: 1 );
+		}
+		else {
+			words[ i ] = ( i )? order[ i-1 ]->elements: 1;
+		}
+	}
+	emit_array( "words", "uint8_t", words, size, FALSE );
+	FREE( words );
+}
+
+/*
+ *	Output the opening of N_find_fetch(), which reads the words of
+ *	an opcode through a callback, and its lazily filled copy of
+ *	them, as used by the walk of each output mode.
+ */
+static void emit_fetch_open( const char *type ) {
+	fprintf( output_source, "typedef %s ( *%s_fetch )( void *context, int index );\n\n", word_type(), data_name );
+	fprintf( output_source, "%s %s%s_find_fetch( %s_fetch fetch, void *context ) {\n", data_scope, type, data_name, data_name );
+	fprintf( output_source, "\t%s\topcode[ %d ];\n", word_type(), maximum_words );
+	fprintf( output_source, "\tunsigned\tloaded = 0;\n" );
+}
+
+/*
+ *	Output the test of the walk of N_find_fetch() which reads word
+ *	'i' the first time it is needed.
+ */
+static void emit_fetch_word( const char *lead ) {
+	fprintf( output_source, "%sif( !( loaded & ( 1u << i ))) {\n", lead );
+	fprintf( output_source, "%s\topcode[ i ] = fetch( context, i );\n", lead );
+	fprintf( output_source, "%s\tloaded |= 1u << i;\n", lead );
+	fprintf( output_source, "%s}\n", lead );
+}
+
+/*
+ *	Return the enum names of the leaves, numbering any name used
+ *	by an earlier leaf.
+ */
+static char **leaf_names( INSTRUCTION **leaf, int leaves ) {
+	char	**names,
+		*buffer = new_text( 1 );
+
+	names = (char **)malloc( sizeof( char * ) * leaves );
+	for( int i = 0; i < leaves; i++ ) {
+		leaf_enum( buffer, leaf[ i ]);
+		for( int j = 0; j < i; j++ ) {
+			if( strcmp( names[ j ], buffer ) == 0 ) {
+				sprintf( buffer + strlen( buffer ), "_%d", i );
+				break;
+			}
+		}
+		names[ i ] = DUP( buffer );
+	}
+	FREE( buffer );
+	return( names );
+}
+
+/*
+ *	Return the number of zero entries added to the end of a node
+ *	array of the given element size, so that a 32 bit gather of
+ *	its last entry stays inside it.
+ */
+static int gather_pad( int bytes ) {
+	return(( batch_output &&( bytes < 4 ))? ( 4 - bytes ) / bytes: 0 );
+}
+
+/*
+ *	Format a gather of node array 'suffix' (of elements of 'bytes'
+ *	bytes) at the vector of indices 'index', for AVX2 (lanes 8)
+ *	or AVX-512 (lanes 16, masked by the live lanes).  Narrow
+ *	entries are cut down by the constants byte and half.
+ */
+static char *gather( char *buffer, int lanes, const char *suffix, int bytes, const char *index ) {
+	char	*array = new_text( 1 ),
+		*load = new_text( 3 );
+
+	sprintf( array, ( constexpr_output )? "%s_%s.data()": "%s_%s", data_name, suffix );
+	if( lanes == 8 ) {
+		sprintf( load, "_mm256_i32gather_epi32(( const int * )%s, %s, %d )", array, index, bytes );
+	}
+	else {
+		sprintf( load, "_mm512_mask_i32gather_epi32( n, live, %s, %s, %d )", index, array, bytes );
+	}
+	if( bytes < 4 ) {
+		sprintf( buffer, "_mm%d_and_si%d( %s, %s )", lanes * 32, lanes * 32, load, ( bytes == 1 )? "byte": "half" );
+	}
+	else {
+		strcpy( buffer, load );
+	}
+	FREE( array );
+	FREE( load );
+	return( buffer );
+}
+
+/*
+ *	Output the AVX2 (lanes 8) or AVX-512 (lanes 16) routine which
+ *	walks a vector of opcodes in lock step, gathering each node's
+ *	entries for every lane at once, until every lane has a leaf.
+ *	What is left over is passed to the interleaved routine.
+ */
+static void emit_batch_vector( int lanes, uint32_t flag, int base, int b ) {
+	const char	*v = ( lanes == 8 )? "_mm256": "_mm512",
+			*index = ( lanes == 8 )? "at": "n";
+	char		*g = new_text( 4 );
+	int		bits = lanes * 32;
+
+	fprintf( output_source, "__attribute__(( target( \"%s\" )))\n", ( lanes == 8 )? "avx2": "avx512f" );
+	fprintf( output_source, "static void %s_find_%s( const %s *opcode, size_t count, enum %s_id *leaf ) {\n",
+			data_name, ( lanes == 8 )? "avx2": "avx512", word_type(), data_name );
+	fprintf( output_source, "\tconst __m%di\tflag = %s_set1_epi32( 0x%X ),\n", bits, v, flag );
+	if(( base == 2 )||( b == 2 )) fprintf( output_source, "\t\t\thalf = %s_set1_epi32( 0xFFFF ),\n", v );
+	if( field_bits <= 1 ) fprintf( output_source, "\t\t\tone = %s_set1_epi32( 1 ),\n", v );
+	fprintf( output_source, "\t\t\tbyte = %s_set1_epi32( 0xFF );\n", v );
+	fprintf( output_source, "\tsize_t\t\ti;\n\n" );
+	fprintf( output_source, "\tfor( i = 0; i + %d <= count; i += %d ) {\n", lanes, lanes );
+	fprintf( output_source, "\t\tuint32_t\tt[ %d ];\n", lanes );
+	fprintf( output_source, "\t\t__m%di\t\top,\n\t\t\t\tn = %s_setzero_si%d(),\n", bits, v, bits );
+	if( lanes == 8 ) fprintf( output_source, "\t\t\t\tdone = _mm256_setzero_si256(),\n\t\t\t\tat,\n" );
+	fprintf( output_source, "\t\t\t\tbit,\n\t\t\t\tk;\n" );
+	if( lanes == 16 ) fprintf( output_source, "\t\t__mmask16\tlive = 0xFFFF;\n" );
+	fprintf( output_source, "\n\t\tfor( int j = 0; j < %d; j++ ) t[ j ] = opcode[ i + j ];\n", lanes );
+	if( lanes == 8 ) {
+		fprintf( output_source, "\t\top = _mm256_loadu_si256(( const __m256i * )t );\n" );
+		fprintf( output_source, "\t\twhile( _mm256_movemask_epi8( done ) != -1 ) {\n" );
+		/*
+		 *	Finished lanes walk node zero, and keep their leaf.
+		 */
+		fprintf( output_source, "\t\t\tat = _mm256_andnot_si256( done, n );\n" );
+	}
+	else {
+		fprintf( output_source, "\t\top = _mm512_loadu_si512( t );\n" );
+		fprintf( output_source, "\t\twhile( live ) {\n" );
+	}
+	fprintf( output_source, "\t\t\tbit = %s;\n", gather( g, lanes, "bit", 1, index ));
+	if( field_bits > 1 ) {
+		fprintf( output_source, "\t\t\tk = %s_and_si%d( %s_srlv_epi32( op, bit ), %s );\n", v, bits, v, gather( g, lanes, "mask", 1, index ));
+		fprintf( output_source, "\t\t\tk = %s_add_epi32( k, %s );\n", v, gather( g, lanes, "base", base, index ));
+	}
+	else {
+		fprintf( output_source, "\t\t\tk = %s_and_si%d( %s_srlv_epi32( op, bit ), one );\n", v, bits, v );
+		fprintf( output_source, "\t\t\tk = %s_or_si%d( %s_slli_epi32( %s, 1 ), k );\n", v, bits, v, index );
+	}
+	if( lanes == 8 ) {
+		fprintf( output_source, "\t\t\tn = _mm256_blendv_epi8( %s, n, done );\n", gather( g, lanes, "child", b, "k" ));
+		fprintf( output_source, "\t\t\tdone = _mm256_cmpeq_epi32( _mm256_and_si256( n, flag ), flag );\n" );
+		fprintf( output_source, "\t\t}\n" );
+		fprintf( output_source, "\t\t_mm256_storeu_si256(( __m256i * )t, n );\n" );
+	}
+	else {
+		fprintf( output_source, "\t\t\tn = _mm512_mask_mov_epi32( n, live, %s );\n", gather( g, lanes, "child", b, "k" ));
+		fprintf( output_source, "\t\t\tlive = _mm512_mask_testn_epi32_mask( live, n, flag );\n" );
+		fprintf( output_source, "\t\t}\n" );
+		fprintf( output_source, "\t\t_mm512_storeu_si512( t, n );\n" );
+	}
+	fprintf( output_source, "\t\tfor( int j = 0; j < %d; j++ ) leaf[ i + j ] = ( enum %s_id )( t[ j ] & 0x%X );\n",
+			lanes, data_name, flag - 1 );
+	fprintf( output_source, "\t}\n" );
+	fprintf( output_source, "\t%s_find_lanes( opcode + i, count - i, leaf + i );\n", data_name );
+	fprintf( output_source, "}\n\n" );
+	FREE( g );
+}
+
+/*
+ *	Output the routine N_find_many() decoding a batch of opcodes
+ *	into leaf numbers.  Each walk is a chain of dependent loads, so
+ *	several are walked at once: with AVX-512 or AVX2 gathers where
+ *	the processor has them (checked at run time), otherwise by
+ *	interleaving eight scalar walks in lock step.  A finished lane
+ *	keeps its leaf (walking node zero) rather than branching out,
+ *	so the only branch is the test that every lane has finished.
+ */
+static void emit_batch( NODE *tree, uint32_t flag, int base, int b ) {
+	emit_comment( "Decode a batch of opcodes into leaf numbers.", NULL );
+	fprintf( output_source, "#include <stddef.h>\n" );
+	fprintf( output_source, "static void %s_find_lanes( const %s *opcode, size_t count, enum %s_id *leaf ) {\n",
+			data_name, word_type(), data_name );
+	if( tree->leaf ) {
+		fprintf( output_source, "\tfor( size_t i = 0; i < count; i++ ) leaf[ i ] = ( enum %s_id )%d;\n", data_name, leaf_id( tree ));
+		fprintf( output_source, "}\n\n" );
+	}
+	else {
+		fprintf( output_source, "\tsize_t\ti;\n\n" );
+		fprintf( output_source, "\tfor( i = 0; i + 8 <= count; i += 8 ) {\n" );
+		fprintf( output_source, "\t\tuint32_t\tn[ 8 ] = { 0 },\n\t\t\t\tlive;\n\n" );
+		fprintf( output_source, "\t\tdo {\n\t\t\tlive = 0;\n" );
+		fprintf( output_source, "\t\t\tfor( int j = 0; j < 8; j++ ) {\n" );
+		/*
+		 *	Finished lanes walk node zero, and keep their leaf.
+		 */
+		fprintf( output_source, "\t\t\t\tuint32_t\tm = ( n[ j ] & 0x%X )? 0: n[ j ],\n", flag );
+		if( field_bits > 1 ) {
+			fprintf( output_source, "\t\t\t\t\t\tc = %s_child[ %s_base[ m ] + (( opcode[ i + j ] >> %s_bit[ m ]) & %s_mask[ m ])];\n\n",
+					data_name, data_name, data_name, data_name );
+		}
+		else {
+			fprintf( output_source, "\t\t\t\t\t\tc = %s_child[( m << 1 )|(( opcode[ i + j ] >> %s_bit[ m ]) & 1 )];\n\n",
+					data_name, data_name );
+		}
+		fprintf( output_source, "\t\t\t\tn[ j ] = ( n[ j ] & 0x%X )? n[ j ]: c;\n", flag );
+		fprintf( output_source, "\t\t\t\tlive |= ~n[ j ] & 0x%X;\n", flag );
+		fprintf( output_source, "\t\t\t}\n\t\t} while( live );\n" );
+		fprintf( output_source, "\t\tfor( int j = 0; j < 8; j++ ) leaf[ i + j ] = ( enum %s_id )( n[ j ] & 0x%X );\n", data_name, flag - 1 );
+		fprintf( output_source, "\t}\n" );
+		fprintf( output_source, "\tfor( ; i < count; i++ ) leaf[ i ] = %s_find( opcode[ i ]);\n", data_name );
+		fprintf( output_source, "}\n\n" );
+		fprintf( output_source, "#if defined( __GNUC__ )&&( defined( __x86_64__ )|| defined( __i386__ ))\n" );
+		fprintf( output_source, "#include <immintrin.h>\n" );
+		emit_batch_vector( 8, flag, base, b );
+		emit_batch_vector( 16, flag, base, b );
+		fprintf( output_source, "#endif\n\n" );
+	}
+	fprintf( output_source, "%s void %s_find_many( const %s *opcode, size_t count, enum %s_id *leaf ) {\n",
+			data_scope, data_name, word_type(), data_name );
+	if( !tree->leaf ) {
+		fprintf( output_source, "#if defined( __GNUC__ )&&( defined( __x86_64__ )|| defined( __i386__ ))\n" );
+		fprintf( output_source, "\tif( __builtin_cpu_supports( \"avx512f\" )) {\n\t\t%s_find_avx512( opcode, count, leaf );\n\t\treturn;\n\t}\n", data_name );
+		fprintf( output_source, "\tif( __builtin_cpu_supports( \"avx2\" )) {\n\t\t%s_find_avx2( opcode, count, leaf );\n\t\treturn;\n\t}\n", data_name );
+		fprintf( output_source, "#endif\n" );
+	}
+	fprintf( output_source, "\t%s_find_lanes( opcode, count, leaf );\n", data_name );
+	fprintf( output_source, "}\n\n" );
+}
+
+/*
+ *	Output the decoder as a structure of arrays.
+ */
+static void emit_arrays( NODE *tree, int count ) {
+	INSTRUCTION	**leaf;
+	NODE		**nodes;
+	char		**names,
+			*buffer = new_text( 1 ),
+			*type = new_text( 1 ),
+			note[ MAX_BUFFER ];
+	uint32_t	*value,
+			flag;
+	int		leaves,
+			size,
+			children,
+			bytes,
+			rows,
+			base = 0,
+			b;
+	const char	*op;
+
+	leaves = count + 1;
+	tree = share( tree );
+	unplace( tree );
+	nodes = (NODE **)malloc( sizeof( NODE * ) * count_rows( tree ));
+	size = number_nodes( tree, nodes, 0 );
+	/*
+	 *	A tree which is just a leaf has no nodes, but the arrays
+	 *	the walk names still need an (unused) entry each.
+	 */
+	rows = ( size )? size: 1;
+	/*
+	 *	Children are numbered nodes or flagged leaves, so the type
+	 *	must hold the larger of the two below its top bit.
+	 */
+	b = (( size <= 0x80 )&&( leaves <= 0x80 ))? 1: ((( size <= 0x8000 )&&( leaves <= 0x8000 ))? 2: 4 );
+	flag = (uint32_t)1 << (( b << 3 ) - 1 );
+	children = 0;
+	for( int i = 0; i < size; i++ ) children += 1 << nodes[ i ]->op_bits;
+	bytes = size * (( maximum_words > 1 )? 2: 1 ) + children * b;
+	if( field_bits > 1 ) bytes += size * ( 1 + (( children <= 0xFF )? 1: (( children <= 0xFFFF )? 2: 4 )));
+	sprintf( note, "Decoder arrays of %d nodes (%d bytes) and %d leaves.", size, bytes, leaves );
+	table_form = "arrays";
+	table_entries = size;
+	table_bytes = bytes;
+	fprintf( stderr, "%s\n", note );
+	emit_comment( note, NULL );
+	emit_stdint();
+	/*
+	 *	Name the leaves, numbering any names used twice.
+	 */
+	leaf = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * leaves );
+	for( int i = 0; i < leaves; leaf[ i++ ] = NULL );
+	collect_leaves( tree, leaf );
+	names = leaf_names( leaf, leaves );
+	fprintf( output_source, "enum %s_id {\n", data_name );
+	for( int i = 0; i < leaves; i++ ) fprintf( output_source, "\t%s = %d%c\n", names[ i ], i, ( i < leaves-1 )? ',': ' ' );
+	fprintf( output_source, "};\n\n" );
+	/*
+	 *	The node arrays.
+	 */
+	value = (uint32_t *)malloc( sizeof( uint32_t ) * ((( children > rows )? children: rows ) + 3 ));
+	for( int i = 0; i < rows + 3; value[ i++ ] = 0 );
+	for( int i = 0; i < size; i++ ) value[ i ] = nodes[ i ]->op_bit;
+	emit_array( "bit", "uint8_t", value, rows + gather_pad( 1 ), FALSE );
+	if( maximum_words > 1 ) {
+		for( int i = 0; i < size; i++ ) value[ i ] = nodes[ i ]->op_word;
+		emit_array( "word", "uint8_t", value, rows, FALSE );
+	}
+	if( field_bits > 1 ) {
+		for( int i = 0; i < size; i++ ) value[ i ] = ( 1 << nodes[ i ]->op_bits ) - 1;
+		emit_array( "mask", "uint8_t", value, rows + gather_pad( 1 ), FALSE );
+		children = 0;
+		for( int i = 0; i < size; i++ ) {
+			value[ i ] = children;
+			children += 1 << nodes[ i ]->op_bits;
+		}
+		base = ( children <= 0xFF )? 1: (( children <= 0xFFFF )? 2: 4 );
+		emit_array( "base", sized_type( base ), value, rows + gather_pad( base ), FALSE );
+	}
+	children = 0;
+	for( int i = 0; i < size; i++ ) {
+		for( int j = 0; j < ( 1 << nodes[ i ]->op_bits ); j++ ) {
+			NODE *n = nodes[ i ]->child[ j ];
+
+			value[ children++ ] = ( n->leaf )? ( flag | (uint32_t)leaf_id( n )): (uint32_t)n->index;
+		}
+	}
+	for( int i = 0; i < 3; value[ children + i++ ] = 0 );
+	emit_array( "child", sized_type( b ), value, (( children )? children: 1 ) + gather_pad( b ), FALSE );
+	FREE( value );
+	/*
+	 *	An array of leaf values for each F record.
 	 */
-	v = FALSE;
-	for( int i = 0; i < MAX_CODES; i++ ) {
-		int j = word_size;
-		while( j-- ) {
-			word k = 1 << j;
-			c1 = 0;
-			c0 = 0;
-			if( mask[ i ] & k ) {
-				for( INSTRUCTION *l = list; l; l = l->next ) {
-					if( l->mask[ i ] & k ) {
-						if( l->opcode[ i ] & k ) {
-							c1++;
-						}
-						else {
-							c0++;
-						}
-					}
-				}
+	for( int f = 0; f < (( output_formats )? output_formats: 1 ); f++ ) {
+		if( output_formats > 1 ) {
+			sprintf( buffer, "%s_value%d", data_name, f+1 );
+		}
+		else {
+			sprintf( buffer, "%s_value", data_name );
+		}
+		/*
+		 *	The values themselves are constant, whatever they
+		 *	point to.
+		 */
+		if( constexpr_output ) {
+			strcpy( type, ( f < value_types )? value_type[ f ]: data_type );
+		}
+		else {
+			sprintf( type, "%s const", ( f < value_types )? value_type[ f ]: data_type );
+		}
+		emit_array_open( "", type, buffer, leaves, FALSE );
+		for( int i = 0; i < leaves; i++ ) {
+			const char *name = ( leaf[ i ])? leaf[ i ]->name: error_handler;
+
+			if( name == NULL ) {
+				fprintf( output_source, "\tNULL" );
 			}
-			if(( c1 + c0 ) == count ) {
-				int x = (( c1 < c0 )?( c0 - c1 ):( c1 - c0 ));
-				if( v ) {
-					if( x < d ) {
-						d = x;
-						w = i;
-						b = j;
-					}
+			else {
+				if( output_formats ) {
+					fprintf( output_source, "\t%s%s%s", output_format_a[ f ], name, output_format_b[ f ]);
 				}
 				else {
-					v = TRUE;
-					d = x;
-					w = i;
-					b = j;
+					fprintf( output_source, "\t%s", name );
 				}
 			}
+			fprintf( output_source, "%c\t%s %s %s\n", ( i < leaves-1 )? ',': ' ', output_comment_a, names[ i ], output_comment_b );
 		}
+		emit_array_close();
+		fprintf( output_source, "\n" );
 	}
+	for( int i = 0; i < leaves; i++ ) FREE( names[ i ]);
+	FREE( names );
 	/*
-	 *	How did we do?
+	 *	The routine walks the nodes to find the leaf number.
 	 */
-	if( !v ) {
+	op = ( maximum_words > 1 )? "opcode[ %s_word[ n ]]": "opcode";
+	sprintf( buffer, op, data_name );
+	emit_comment( "Find the leaf number which decodes an opcode.", NULL );
+	if( constexpr_output ) {
+		fprintf( output_source, "%s constexpr enum %s_id %s_find( ", data_scope, data_name, data_name );
+	}
+	else {
+		fprintf( output_source, "%s enum %s_id %s_find( ", data_scope, data_name, data_name );
+	}
+	if( maximum_words > 1 ) {
+		fprintf( output_source, "const %s *opcode ) {\n", word_type());
+	}
+	else {
+		fprintf( output_source, "%s opcode ) {\n", word_type());
+	}
+	if( tree->leaf ) {
+		fprintf( output_source, "\tuint32_t\tn = 0x%X;\n\n", flag | (uint32_t)leaf_id( tree ));
+	}
+	else {
+		fprintf( output_source, "\tuint32_t\tn = 0;\n\n" );
+	}
+	if( field_bits > 1 ) {
+		fprintf( output_source, "\twhile( !( n & 0x%X )) n = %s_child[ %s_base[ n ] + (( %s >> %s_bit[ n ]) & %s_mask[ n ])];\n",
+				flag, data_name, data_name, buffer, data_name, data_name );
+	}
+	else {
+		fprintf( output_source, "\twhile( !( n & 0x%X )) n = %s_child[( n << 1 )|(( %s >> %s_bit[ n ]) & 1 )];\n",
+				flag, data_name, buffer, data_name );
+	}
+	fprintf( output_source, "\treturn(( enum %s_id )( n & 0x%X ));\n", data_name, flag - 1 );
+	fprintf( output_source, "}\n\n" );
+	if( lazy_fetch ) {
 		/*
-		 *	There was no means to differentiate the instructions
-		 *	in the list..
+		 *	And again, fetching each word as it is tested.
 		 */
-		fprintf( stderr, "----------------------\n" );
-		for( ptr = list; ptr; ptr = ptr->next ) {
-			fprintf( stderr, "Duplicate Instruction '%s' line %d.\n", ptr->name, ptr->line );
-			dropped++;
+		emit_comment( "Find the leaf number which decodes an opcode, fetching its words as tested.", NULL );
+		emit_words( NULL, 0, leaf + 1, count );
+		sprintf( type, "enum %s_id ", data_name );
+		emit_fetch_open( type );
+		if( tree->leaf ) {
+			fprintf( output_source, "\tuint32_t\tn = 0x%X;\n\n", flag | (uint32_t)leaf_id( tree ));
 		}
-		fprintf( stderr, "----------------------\n" );
-		/* Error Leaf node time! */
-		here = NEW( NODE );
-		here->index = 0;
-		here->leaf = TRUE;
-		here->decoded = NULL;
-		here->op_word = 0;
-		here->op_bit = 0;
-		here->zero = NULL;
-		here->one = NULL;
-		return( here );
-	}
-	/*
-	 *	Set the testing bit.
-	 */
-	t = 1 << b;
-	/*
-	 *	Run through the list and divide up.
-	 */
-	ones = NULL;	c1 = 0;
-	zeros = NULL;	c0 = 0;
-	while(( ptr = list )) {
-		list = list->next;
-		if( ptr->opcode[ w ] & t ) {
-			ptr->next = ones;
-			ones = ptr;
-			c1++;
+		else {
+			fprintf( output_source, "\tuint32_t\tn = 0;\n\n" );
+		}
+		fprintf( output_source, "\twhile( !( n & 0x%X )) {\n", flag );
+		fprintf( output_source, "\t\tint\ti = %s_word[ n ];\n\n", data_name );
+		emit_fetch_word( "\t\t" );
+		if( field_bits > 1 ) {
+			fprintf( output_source, "\t\tn = %s_child[ %s_base[ n ] + (( opcode[ i ] >> %s_bit[ n ]) & %s_mask[ n ])];\n",
+					data_name, data_name, data_name, data_name );
 		}
 		else {
-			ptr->next = zeros;
-			zeros = ptr;
-			c0++;
+			fprintf( output_source, "\t\tn = %s_child[( n << 1 )|(( opcode[ i ] >> %s_bit[ n ]) & 1 )];\n", data_name, data_name );
 		}
+		fprintf( output_source, "\t}\n" );
+		fprintf( output_source, "\treturn(( enum %s_id )( n & 0x%X ));\n", data_name, flag - 1 );
+		fprintf( output_source, "}\n\n" );
 	}
-	/*
-	 *	Make decision node and process the limbs.
-	 */
-	here = NEW( NODE );
-	here->index = 0;
-	here->leaf = FALSE;
-	here->decoded = NULL;
-	here->op_word = w;
-	here->op_bit = b;
-	mask[ w ] &= ~t;
-	here->zero = insert( mask, zeros, c0 );
-	here->one = insert( mask, ones, c1 );
-	mask[ w ] |= t;
-	return( here );
+	FREE( leaf );
+	if( batch_output ) emit_batch( tree, flag, base, b );
+	FREE( nodes );
+	FREE( buffer );
+	FREE( type );
 }
 
 /*
- *	Sequence the table into a conceptual array.
+ *	Output N_find_fetch(), walking the table (with the loop, even
+ *	when N_find() is unrolled) and fetching each word of the opcode
+ *	the first time a row tests it, and the length of each row's
+ *	instruction.
  */
-static int sequence( NODE *node, int index ) {
-	if( node ) {
-		node->index = index++;
-		index = sequence( node->zero, index );
-		index = sequence( node->one, index );
+static void emit_table_fetch( NODE **rows, int size, INSTRUCTION **order, int count ) {
+	char	*type = new_text( 1 );
+
+	emit_comment( "Find the table row which decodes an opcode, fetching its words as tested.", NULL );
+	emit_words( rows, size, order, count );
+	sprintf( type, "%s *", data_type );
+	emit_fetch_open( type );
+	fprintf( output_source, "\t%s\t*ptr;\n", data_type );
+	fprintf( output_source, "\t%s\tmask;\n\n", word_type());
+	fprintf( output_source, "\tptr = %s;\n", data_name );
+	fprintf( output_source, "\twhile(( mask = ptr->mask )) {\n" );
+	fprintf( output_source, "\t\tint\ti = ptr->index;\n\n" );
+	emit_fetch_word( "\t\t" );
+	fprintf( output_source, "\t\t" );
+	emit_table_step( "opcode[ i ]" );
+	fprintf( output_source, "\t}\n" );
+	fprintf( output_source, "\treturn( ptr );\n" );
+	fprintf( output_source, "}\n\n" );
+	FREE( type );
+}
+
+/*
+ *	Give the type N_find() returns, the value which is never
+ *	returned, and how to turn a result 's' into the table row (or
+ *	leaf number) it was found at.
+ */
+static void find_result( char *type, char *empty, char *index, int count ) {
+	if( output_mode == ARRAYS_OUTPUT ) {
+		sprintf( type, "enum %s_id ", data_name );
+		sprintf( empty, "%d", count + 1 );
+		strcpy( index, "s" );
+	}
+	else {
+		sprintf( type, "%s%s *", ( constexpr_output )? "const ": "", data_type );
+		strcpy( empty, "NULL" );
+		sprintf( index, ( constexpr_output )? "s - %s.data()": "s - %s", data_name );
 	}
-	return( index );
 }
 
 /*
- *	Output the decoder tree.
+ *	Format the name of the extractor of an operand letter of an
+ *	instruction, numbering names used by an earlier instruction.
  */
-static int emit_decoder( NODE *node, int left ) {
-	char		sep;
-	word		look;
+static void operand_name( char *buffer, INSTRUCTION **order, int id, int letter ) {
+	char	*p;
 
-	sep = ( left > 1 )?',':' ';
-	
-	if( node->leaf ) {
-		INSTRUCTION	*ptr;
-		
-		if(( ptr = node->decoded )) {
-			if( maximum_words > 1 ) {
-				fprintf( output_source, "\t{ 0, " );
-			}
-			else {
-				fprintf( output_source, "\t{ " );
-			}
-			fprintf( output_source, "0, 0" );
-			if( output_formats ) {
-				for( int i = 0; i < output_formats; i++ ) {
-					fprintf( output_source, ", %s%s%s",
-							output_format_a[ i ],
-							ptr->name,			/* Leaf node function name */
-							output_format_b[ i ]);
-				}
-			}
-			else {
-				fprintf( output_source, ", %s", ptr->name );		/* Leaf node function name */
-			}
-			fprintf( output_source, " }%c\t%s [%3d]%3d",
-					sep,
-					output_comment_a,
-					node->index,		/* The index number of this node */
-					ptr->line );		/* The line number of the configuration file */
-			for( int i = 0; i < MAX_CODES; i++ ) {
-				if( ptr->description[ i ]) {
-					fprintf( output_source, "\t%s", ptr->description[ i ]);
-				}
-			}
-			if( ptr->matches > 1 ) {
-				fprintf( output_source, " [%d", ptr->matches );
-				for( int i = 0; i < MAX_CODES; i++ ) {
-					if( ptr->description[ i ]) {
-						look = 1 << ( strlen( ptr->description[ i ])-1 );
-						fprintf( output_source, " " );
-						while( look ) {
-							if( ptr->unmatched[ i ] & look ) {
-								fprintf( output_source, "%c", PLACE_VARIABLE );
-							}
-							else {
-								fprintf( output_source, "%c", (( look & PLACE_PATTERN )? PLACE_MARK: PLACE_GAP ));
-							}
-							look >>= 1;
-						}
-						fprintf( output_source, "]" );
-					}
-				}
+	sprintf( buffer, "%s_%s", data_name, order[ id-1 ]->name );
+	for( int i = 1; i < id; i++ ) {
+		if( strcmp( order[ i-1 ]->name, order[ id-1 ]->name ) == 0 ) {
+			sprintf( buffer + strlen( buffer ), "_%d", id );
+			break;
+		}
+	}
+	for( p = buffer; *p; p++ ) if( !isalnum( *p )) *p = '_';
+	sprintf( p, "_%c", letter );
+}
+
+/*
+ *	Return the number of bits of an instruction marked with a
+ *	letter, the mask of them in each word going into 'mask'.
+ */
+static int operand_bits( INSTRUCTION *ptr, int letter, word *mask ) {
+	int	bits = 0;
+
+	for( int i = 0; i < ptr->elements; i++ ) {
+		int	len = strlen( ptr->description[ i ]);
+
+		mask[ i ] = 0;
+		for( int j = 0; j < len; j++ ) {
+			if( ptr->description[ i ][ j ] == letter ) {
+				mask[ i ] |= ((word)1) << ( len - 1 - j );
+				bits++;
 			}
-			fprintf( output_source, " %s %s\n",
-				ptr->comment,		/* The commentary text associated with this line */
-				output_comment_b );
+		}
+	}
+	return( bits );
+}
+
+/*
+ *	Output an extractor of an operand, merging the bits marked by
+ *	its letter (the first word's being the most significant) with
+ *	a shift and mask for each run of them, or with pext for each
+ *	word when compiled for BMI2.
+ */
+static void emit_extractor( INSTRUCTION **order, int id, int letter ) {
+	INSTRUCTION	*ptr = order[ id-1 ];
+	word		mask[ MAX_CODES ];
+	char		*name = new_text( 1 ),
+			op[ MAX_BUFFER ];
+	const char	*type,
+			*cast;
+	int		bits,
+			dest,
+			pext = ( word_size > 32 )? 64: 32;
+	bool		first;
+
+	bits = operand_bits( ptr, letter, mask );
+	type = ( bits > 32 )? "uint64_t": "uint32_t";
+	/*
+	 *	Runs are shifted at the wider of the operand and the word
+	 *	so that none of the upper bits of a long word are lost.
+	 */
+	cast = (( bits > 32 )||( word_size > 32 ))? "uint64_t": "uint32_t";
+	operand_name( name, order, id, letter );
+	fprintf( output_source, "static inline %s %s( ", type, name );
+	if( ptr->elements > 1 ) {
+		fprintf( output_source, "const %s *opcode ) {\n", word_type());
+	}
+	else {
+		fprintf( output_source, "%s opcode ) {\n", word_type());
+	}
+	fprintf( output_source, "#if defined( __BMI2__ )\n\treturn( " );
+	dest = bits;
+	first = TRUE;
+	for( int i = 0; i < ptr->elements; i++ ) {
+		int n = 0;
+
+		if( mask[ i ] == 0 ) continue;
+		for( word m = mask[ i ]; m; m &= m - 1 ) n++;
+		dest -= n;
+		sprintf( op, ( ptr->elements > 1 )? "opcode[ %d ]": "opcode", i );
+		if( dest ) {
+			fprintf( output_source, "%s(( %s )_pext_u%d( %s, 0x%" PRIX64 " ) << %d )", ( first )? "": "|", type, pext, op, (uint64_t)mask[ i ], dest );
 		}
 		else {
+			fprintf( output_source, "%s( %s )_pext_u%d( %s, 0x%" PRIX64 " )", ( first )? "": "|", type, pext, op, (uint64_t)mask[ i ]);
+		}
+		first = FALSE;
+	}
+	if( strcmp( type, cast )) {
+		fprintf( output_source, " );\n#else\n\treturn(( %s )( ", type );
+	}
+	else {
+		fprintf( output_source, " );\n#else\n\treturn( " );
+	}
+	dest = bits;
+	first = TRUE;
+	for( int i = 0; i < ptr->elements; i++ ) {
+		sprintf( op, ( ptr->elements > 1 )? "opcode[ %d ]": "opcode", i );
+		for( int j = word_size - 1; j >= 0; j-- ) {
+			int	n = 0,
+				b;
+
+			if( !( mask[ i ] & ((word)1 << j ))) continue;
+			while(( j - n >= 0 )&&( mask[ i ] & ((word)1 << ( j - n )))) n++;
+			b = j - n + 1;
+			dest -= n;
 			/*
-			 *	Not a decoded instruction, an illegal one.
+			 *	Move the run of n bits from bit b to bit dest.
 			 */
-			if( maximum_words > 1 ) {
-				fprintf( output_source, "\t{ 0, " );
+			fprintf( output_source, "%s", ( first )? "": "|" );
+			if( b > dest ) {
+				fprintf( output_source, "((( %s )%s >> %d ) & 0x%" PRIX64 " )", cast, op, b - dest, (uint64_t)field_mask( dest, n ));
 			}
 			else {
-				fprintf( output_source, "\t{ " );
-			}
-			fprintf( output_source, "0, 0" );
-			if( output_formats ) {
-				for( int i = 0; i < output_formats; i++ ) {
-					fprintf( output_source, ", %s%s%s",
-						output_format_a[ i ],
-						error_handler,		/* Leaf node function name */
-						output_format_b[ i ]);
+				if( b < dest ) {
+					fprintf( output_source, "((( %s )%s << %d ) & 0x%" PRIX64 " )", cast, op, dest - b, (uint64_t)field_mask( dest, n ));
+				}
+				else {
+					fprintf( output_source, "(( %s )%s & 0x%" PRIX64 " )", cast, op, (uint64_t)field_mask( dest, n ));
 				}
 			}
-			else {
-				fprintf( output_source, ", %s", error_handler );
+			first = FALSE;
+			j = b;
+		}
+	}
+	fprintf( output_source, "%s );\n#endif\n}\n\n", ( strcmp( type, cast ))? " )": "" );
+	FREE( name );
+}
+
+/*
+ *	Output the operand extractors of every instruction, one for
+ *	each letter in its I record, then a structure with a member
+ *	for each letter used by any instruction, and a lookup which
+ *	fills it in along with finding the instruction.  The routine
+ *	filling it is switched on the table row found (given the
+ *	rows) or else on the leaf number.
+ */
+static void emit_operands( NODE **rows, int size, INSTRUCTION **order, int count ) {
+	bool	used[ 256 ];
+	int	widest[ 256 ],
+		letters = 0;
+	char	*name,
+		*type,
+		empty[ MAX_BUFFER ],
+		*index;
+	word	mask[ MAX_CODES ];
+	const char	*w = word_type();
+
+	emit_comment( "Extract the operands marked by the letters of each instruction.", NULL );
+	emit_stdint();
+	fprintf( output_source, "#if defined( __BMI2__ )\n#include <immintrin.h>\n#endif\n" );
+	for( int l = 0; l < 256; l++ ) {
+		used[ l ] = FALSE;
+		widest[ l ] = 0;
+	}
+	for( int id = 1; id <= count; id++ ) {
+		INSTRUCTION *ptr = order[ id-1 ];
+
+		for( int l = 0; l < 256; l++ ) {
+			int bits;
+
+			if( !isalpha( l )) continue;
+			if(( bits = operand_bits( ptr, l, mask )) == 0 ) continue;
+			if( bits > 64 ) {
+				fprintf( stderr, "Operand '%c' of instruction '%s' line %d is over 64 bits.\n", l, ptr->name, ptr->line );
+				dropped++;
+				continue;
 			}
-			fprintf( output_source, " }%c\t%s [%3d]\tInvalid Instruction %s\n",
-				sep,
-				output_comment_a,
-				node->index,		/* The index number of this node */
-				output_comment_b );
+			if( !used[ l ]) letters++;
+			used[ l ] = TRUE;
+			if( bits > widest[ l ]) widest[ l ] = bits;
+			emit_extractor( order, id, l );
 		}
-		left--;
 	}
-	else {
-		char	*fmt;
+	if( letters == 0 ) return;
+	name = new_text( 1 );
+	type = new_text( 1 );
+	index = new_text( 1 );
+	/*
+	 *	The structure of all the operands.
+	 */
+	fprintf( output_source, "typedef struct {\n" );
+	for( int l = 0; l < 256; l++ ) {
+		if( used[ l ]) fprintf( output_source, "\t%s\t%c;\n", ( widest[ l ] > 32 )? "uint64_t": "uint32_t", l );
+	}
+	fprintf( output_source, "} %s_operands;\n\n", data_name );
+	/*
+	 *	Filling it in for a result of N_find(), where the opcode
+	 *	points at all the words of the instruction.
+	 */
+	find_result( type, empty, index, count );
+	if( rows == NULL ) size = count + 1;
+	fprintf( output_source, "%s void %s_operands_fill( %ss, const %s *opcode, %s_operands *operands ) {\n",
+			data_scope, data_name, type, w, data_name );
+	fprintf( output_source, "\tswitch( %s ) {\n", index );
+	for( int id = 1; id <= count; id++ ) {
+		INSTRUCTION	*ptr = order[ id-1 ];
+		int		cases = 0;
 
-		if( node->op_word >= maximum_words ) {
-			fprintf( stderr, "Maximum words value exceeded at array index %d.\n", node->index );
-			dropped++;
+		for( int l = 0; l < 256; l++ ) if( used[ l ]&& operand_bits( ptr, l, mask )) cases++;
+		if( cases == 0 ) continue;
+		cases = 0;
+		for( int i = 0; i < size; i++ ) {
+			if(( rows )?( rows[ i ]->leaf &&( rows[ i ]->decoded == ptr )):( i == id )) {
+				fprintf( output_source, "%s%scase %d:", (( cases & 7 ) == 0 )? ( cases? "\n": "" ): " ", (( cases & 7 ) == 0 )? "\t\t": "", i );
+				cases++;
+			}
 		}
-		if( maximum_words > 1 ) {
-			fprintf( output_source, "\t{ %d, ", node->op_word );
+		if( cases == 0 ) continue;
+		fprintf( output_source, "\t%s %s %s\n", output_comment_a, ptr->name, output_comment_b );
+		for( int l = 0; l < 256; l++ ) {
+			if( !used[ l ]|| !operand_bits( ptr, l, mask )) continue;
+			operand_name( name, order, id, l );
+			fprintf( output_source, "\t\t\toperands->%c = %s( %s);\n", l, name, ( ptr->elements > 1 )? "opcode ": "opcode[ 0 ]" );
 		}
-		else {
-			fprintf( output_source, "\t{ " );
+		fprintf( output_source, "\t\t\tbreak;\n" );
+	}
+	fprintf( output_source, "\t\tdefault: break;\n\t}\n}\n\n" );
+	/*
+	 *	And the lookup doing both.
+	 */
+	fprintf( output_source, "%s %s%s_find_operands( const %s *opcode, %s_operands *operands ) {\n",
+			data_scope, type, data_name, w, data_name );
+	fprintf( output_source, "\t%ss = %s_find( %s);\n\n", type, data_name, ( maximum_words > 1 )? "opcode ": "opcode[ 0 ]" );
+	fprintf( output_source, "\t%s_operands_fill( s, opcode, operands );\n", data_name );
+	fprintf( output_source, "\treturn( s );\n}\n\n" );
+	FREE( name );
+	FREE( type );
+	FREE( index );
+}
+
+/*
+ *	Output the predecode cache kept by the caller for a program
+ *	image of words: the result of N_find() for the instruction at
+ *	each address (filled on first use, or all at once) with its
+ *	length in words, and a routine clearing the addresses a write
+ *	to the image may change.  The lengths are looked up by the
+ *	table row found (given the rows) or else by leaf number.
+ */
+static void emit_predecode( NODE **rows, int size, INSTRUCTION **order, int count ) {
+	char		*slot = new_text( 1 ),
+			empty[ MAX_BUFFER ],
+			*index = new_text( 1 );
+	const char	*w = word_type();
+
+	emit_comment( "Predecode cache of the instruction at each address of a program image.", NULL );
+	fprintf( output_source, "#include <stddef.h>\n" );
+	emit_words( rows, size, order, count );
+	/*
+	 *	A slot holds what N_find() returns, or 'empty'.
+	 */
+	find_result( slot, empty, index, count );
+	if( output_mode == ARRAYS_OUTPUT ) sprintf( slot, "%s", id_type( count + 1 ));
+	fprintf( output_source, "typedef %s%s%s_slot;\n", slot, ( slot[ strlen( slot )-1 ] == '*' )? "": " ", data_name );
+	fprintf( output_source, "typedef struct {\n" );
+	fprintf( output_source, "\tconst %s\t*image;\t\t%s The program words %s\n", w, output_comment_a, output_comment_b );
+	fprintf( output_source, "\tsize_t\t\tsize;\t\t%s How many there are %s\n", output_comment_a, output_comment_b );
+	fprintf( output_source, "\t%s_slot\t*slot;\t\t%s Decoded instruction at each address %s\n", data_name, output_comment_a, output_comment_b );
+	fprintf( output_source, "\tuint8_t\t\t*words;\t\t%s Its length in words %s\n", output_comment_a, output_comment_b );
+	fprintf( output_source, "} %s_cache;\n\n", data_name );
+	/*
+	 *	Setting up, with every slot empty.
+	 */
+	fprintf( output_source, "%s void %s_cache_init( %s_cache *cache, const %s *image, size_t size, %s_slot *slot, uint8_t *words ) {\n",
+			data_scope, data_name, data_name, w, data_name );
+	fprintf( output_source, "\tcache->image = image;\n\tcache->size = size;\n\tcache->slot = slot;\n\tcache->words = words;\n" );
+	fprintf( output_source, "\tfor( size_t i = 0; i < size; i++ ) slot[ i ] = %s;\n", empty );
+	fprintf( output_source, "}\n\n" );
+	/*
+	 *	Decoding one address into its slot.
+	 */
+	fprintf( output_source, "%s %s_slot %s_cache_fill( %s_cache *cache, size_t address ) {\n",
+			data_scope, data_name, data_name, data_name );
+	fprintf( output_source, "\t%s_slot\ts;\n", data_name );
+	if( maximum_words > 1 ) {
+		fprintf( output_source, "\t%s\t\topcode[ %d ] = { 0 };\n\n", w, maximum_words );
+		fprintf( output_source, "\tfor( size_t i = 0; ( i < %d )&&( address + i < cache->size ); i++ ) opcode[ i ] = cache->image[ address + i ];\n",
+				maximum_words );
+		fprintf( output_source, "\ts = %s_find( opcode );\n", data_name );
+	}
+	else {
+		fprintf( output_source, "\n\ts = %s_find( cache->image[ address ]);\n", data_name );
+	}
+	fprintf( output_source, "\tcache->words[ address ] = %s_words[ %s ];\n", data_name, index );
+	fprintf( output_source, "\treturn( cache->slot[ address ] = s );\n" );
+	fprintf( output_source, "}\n\n" );
+	/*
+	 *	The lookup, one load once the slot is full.
+	 */
+	fprintf( output_source, "%s %s_slot %s_cache_find( %s_cache *cache, size_t address ) {\n",
+			data_scope, data_name, data_name, data_name );
+	fprintf( output_source, "\t%s_slot\ts = cache->slot[ address ];\n\n", data_name );
+	fprintf( output_source, "\treturn(( s != %s )? s: %s_cache_fill( cache, address ));\n", empty, data_name );
+	fprintf( output_source, "}\n\n" );
+	/*
+	 *	Filling the whole image up front.
+	 */
+	fprintf( output_source, "%s void %s_cache_load( %s_cache *cache ) {\n", data_scope, data_name, data_name );
+	fprintf( output_source, "\tfor( size_t i = 0; i < cache->size; i++ ) %s_cache_fill( cache, i );\n", data_name );
+	fprintf( output_source, "}\n\n" );
+	/*
+	 *	A write can change the instructions starting at the words
+	 *	written, or up to W-1 words before them.
+	 */
+	fprintf( output_source, "%s void %s_cache_invalidate( %s_cache *cache, size_t address, size_t count ) {\n",
+			data_scope, data_name, data_name );
+	if( maximum_words > 1 ) {
+		fprintf( output_source, "\tsize_t\tfirst = ( address > %d )? address - %d: 0,\n", maximum_words - 1, maximum_words - 1 );
+	}
+	else {
+		fprintf( output_source, "\tsize_t\tfirst = address,\n" );
+	}
+	fprintf( output_source, "\t\tlast = ( address + count < cache->size )? address + count: cache->size;\n\n" );
+	fprintf( output_source, "\tfor( size_t i = first; i < last; i++ ) cache->slot[ i ] = %s;\n", empty );
+	fprintf( output_source, "}\n\n" );
+	FREE( slot );
+	FREE( index );
+}
+
+/*
+ *	Output the body of the handler stub of a leaf: the user's work
+ *	given the first F record value of the instruction (NULL for
+ *	the error leaf without an E record), then the next dispatch.
+ */
+static void emit_handler( const char *macro, INSTRUCTION *ptr, int id ) {
+	const char	*name = ( ptr )? ptr->name: error_handler;
+
+	if( name == NULL ) {
+		fprintf( output_source, "\t%s_EXECUTE( NULL, 0 );\n", macro );
+	}
+	else {
+		fprintf( output_source, "\t%s_EXECUTE( %s%s%s, %d );\n", macro,
+				( output_formats )? output_format_a[ 0 ]: "", name,
+				( output_formats )? output_format_b[ 0 ]: "", id );
+	}
+	fprintf( output_source, "\t%s_NEXT;\n", macro );
+}
+
+/*
+ *	Output a threaded dispatch skeleton following the decoder: a
+ *	routine N_leaf() giving the leaf number of an opcode (via a
+ *	row to leaf array N_leaf_id[] when given the table rows), and
+ *	a handler stub for each leaf passing the instruction's first F
+ *	record value to the user's N_EXECUTE() macro.  Each handler
+ *	ends by fetching the next opcode and jumping to its handler,
+ *	either by a computed goto through a table of label addresses
+ *	or by a (must) tail call through a table of handler routines.
+ */
+static void emit_dispatch( NODE **rows, int size, INSTRUCTION **order, int count ) {
+	INSTRUCTION	**leaf;
+	uint32_t	*ids;
+	char		**names,
+			*stub,
+			*macro = new_text( 1 ),
+			*type = new_text( 1 ),
+			empty[ MAX_BUFFER ],
+			*index = new_text( 1 );
+	int		leaves = count + 1;
+	const char	*w = word_type();
+
+	/*
+	 *	The handler stubs are named after the leaf's enum name,
+	 *	with N_do_ in place of the N_ and in lower case.
+	 */
+	leaf = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * leaves );
+	leaf[ 0 ] = NULL;
+	for( int i = 1; i < leaves; i++ ) leaf[ i ] = order[ i-1 ];
+	names = leaf_names( leaf, leaves );
+	for( int i = 0; i < leaves; i++ ) {
+		stub = (char *)malloc( strlen( names[ i ]) + 4 );
+		sprintf( stub, "%s_do%s", data_name, names[ i ] + strlen( data_name ));
+		for( char *p = stub + strlen( data_name ); *p; p++ ) *p = tolower( *p );
+		FREE( names[ i ]);
+		names[ i ] = stub;
+	}
+	strcpy( macro, data_name );
+	for( char *p = macro; *p; p++ ) *p = isalnum( *p )? toupper( *p ): '_';
+	emit_comment( "Threaded dispatch of each opcode fetched to the handler of its leaf.", NULL );
+	/*
+	 *	The leaf number of an opcode.
+	 */
+	find_result( type, empty, index, count );
+	if( rows ) {
+		ids = (uint32_t *)malloc( sizeof( uint32_t ) * size );
+		for( int i = 0; i < size; i++ ) ids[ i ] = ( rows[ i ]->leaf )? leaf_id( rows[ i ]): 0;
+		emit_array( "leaf_id", id_type( leaves ), ids, size, FALSE );
+		FREE( ids );
+	}
+	if( maximum_words > 1 ) {
+		fprintf( output_source, "static inline unsigned %s_leaf( const %s *opcode ) {\n", data_name, w );
+	}
+	else {
+		fprintf( output_source, "static inline unsigned %s_leaf( %s opcode ) {\n", data_name, w );
+	}
+	fprintf( output_source, "\t%ss = %s_find( opcode );\n\n", type, data_name );
+	if( rows ) {
+		fprintf( output_source, "\treturn( %s_leaf_id[ %s ]);\n}\n\n", data_name, index );
+	}
+	else {
+		fprintf( output_source, "\treturn( %s );\n}\n\n", index );
+	}
+	/*
+	 *	What the user supplies: the next opcode, the work of a
+	 *	handler, and the parameters (state) handed along.
+	 */
+	fprintf( output_source, "#if !defined( %s_FETCH )||!defined( %s_EXECUTE )\n", macro, macro );
+	fprintf( output_source, "#error \"Define %s_FETCH() and %s_EXECUTE( handler, leaf ) for the dispatch skeleton.\"\n", macro, macro );
+	fprintf( output_source, "#endif\n" );
+	fprintf( output_source, "#if !defined( %s_PARAMS )\n#define %s_PARAMS void\n#define %s_ARGS\n#endif\n", macro, macro, macro );
+	if( dispatch_form == GOTO_DISPATCH ) {
+		/*
+		 *	One routine, each handler a label.  Without labels
+		 *	as values every handler jumps back to a switch.
+		 */
+		fprintf( output_source, "%s int %s_run( %s_PARAMS ) {\n", data_scope, data_name, macro );
+		fprintf( output_source, "#if defined( __GNUC__ )\n" );
+		fprintf( output_source, "\tstatic void *const label[ %d ] = {\n", leaves );
+		for( int i = 0; i < leaves; i++ ) {
+			fprintf( output_source, "\t\t&&%s%c\n", names[ i ], ( i < leaves-1 )? ',': ' ' );
 		}
-		switch( word_size ) {
-			case 8: {
-				fmt = "0x%02X, %d";
-				break;
-			}
-			case 16: {
-				fmt = "0x%04X, %d";
-				break;
-			}
-			case 32: {
-				fmt = "0x%08X, %d";
-				break;
-			}
-			default: {
-				fmt = "0x%X, %d";
-				break;
-			}
+		fprintf( output_source, "\t};\n" );
+		fprintf( output_source, "#define %s_NEXT goto *label[ %s_leaf( %s_FETCH())]\n", macro, data_name, macro );
+		fprintf( output_source, "#else\n" );
+		fprintf( output_source, "#define %s_NEXT goto next\n", macro );
+		fprintf( output_source, "next:\n\tswitch( %s_leaf( %s_FETCH())) {\n", data_name, macro );
+		for( int i = 0; i < leaves; i++ ) {
+			fprintf( output_source, "\t\tcase %d: goto %s;\n", i, names[ i ]);
 		}
-		fprintf( output_source, fmt,
-			(((word)1) << node->op_bit ),
-			node->one->index - node->index );	/* Relative distance down array */
-		if( output_formats ) {
-			for( int i = 0; i < output_formats; i++ ) fprintf( output_source, ", NULL" );
+		fprintf( output_source, "\t}\n" );
+		fprintf( output_source, "#endif\n" );
+		fprintf( output_source, "\t%s_NEXT;\n", macro );
+		for( int i = 0; i < leaves; i++ ) {
+			fprintf( output_source, "%s:\t%s %s %s\n", names[ i ], output_comment_a, ( leaf[ i ])? leaf[ i ]->name: "Invalid opcode", output_comment_b );
+			emit_handler( macro, leaf[ i ], i );
 		}
-		else {
-			fprintf( output_source, ", NULL" );
+		fprintf( output_source, "#undef %s_NEXT\n}\n\n", macro );
+	}
+	else {
+		/*
+		 *	A routine for each handler, each passing the same
+		 *	parameters on so the call can be made a jump.
+		 */
+		fprintf( output_source, "typedef int ( *%s_handler )( %s_PARAMS );\n", data_name, macro );
+		for( int i = 0; i < leaves; i++ ) fprintf( output_source, "static int %s( %s_PARAMS );\n", names[ i ], macro );
+		fprintf( output_source, "static const %s_handler %s_handlers[ %d ] = {\n", data_name, data_name, leaves );
+		for( int i = 0; i < leaves; i++ ) {
+			fprintf( output_source, "\t%s%c\n", names[ i ], ( i < leaves-1 )? ',': ' ' );
 		}
-		fprintf( output_source, " }%c\t%s [%3d]\t%s\n",
-			sep,
-			output_comment_a,
-			node->index,			/* The index number of this node */
-			output_comment_b );
+		fprintf( output_source, "};\n" );
+		fprintf( output_source, "#if defined( __has_attribute )\n#if __has_attribute( musttail )\n" );
+		fprintf( output_source, "#define %s_MUSTTAIL __attribute__(( musttail ))\n", macro );
+		fprintf( output_source, "#endif\n#endif\n" );
+		fprintf( output_source, "#if !defined( %s_MUSTTAIL )\n#define %s_MUSTTAIL\n#endif\n", macro, macro );
+		fprintf( output_source, "#define %s_NEXT %s_MUSTTAIL return( %s_handlers[ %s_leaf( %s_FETCH())]( %s_ARGS ))\n",
+				macro, macro, data_name, data_name, macro, macro );
+		for( int i = 0; i < leaves; i++ ) {
+			fprintf( output_source, "static int %s( %s_PARAMS ) {\t%s %s %s\n", names[ i ], macro, output_comment_a, ( leaf[ i ])? leaf[ i ]->name: "Invalid opcode", output_comment_b );
+			emit_handler( macro, leaf[ i ], i );
+			fprintf( output_source, "}\n" );
+		}
+		fprintf( output_source, "%s int %s_run( %s_PARAMS ) {\n\t%s_NEXT;\n}\n", data_scope, data_name, macro, macro );
+		fprintf( output_source, "#undef %s_NEXT\n\n", macro );
+	}
+	for( int i = 0; i < leaves; i++ ) FREE( names[ i ]);
+	FREE( names );
+	FREE( leaf );
+	FREE( macro );
+	FREE( type );
+	FREE( index );
+}
+
+/*
+ *	Output the benchmark harness, a main() timing N_find() over
+ *	each stream of opcodes in blocks of N_BENCH_BLOCK calls, each
+ *	stream repeated until at least N_BENCH_DECODES calls are made.
+ *	Timing single calls would only measure the clock, so the
+ *	percentiles are of the time per call within a block.
+ */
+static void emit_benchmark( void ) {
+	char		*macro = new_text( 1 ),
+			*call = new_text( 1 );
+	const char	*w = word_type();
+	int		bytes = ( word_size + 7 ) >> 3;
 
-		left--;
-		left = emit_decoder( node->zero, left );
-		left = emit_decoder( node->one, left );
+	strcpy( macro, data_name );
+	for( char *p = macro; *p; p++ ) *p = isalnum( *p )? toupper( *p ): '_';
+	if( maximum_words > 1 ) {
+		sprintf( call, "%s_find( opcode + j * %d )", data_name, maximum_words );
+	}
+	else {
+		sprintf( call, "%s_find( opcode[ j ])", data_name );
+	}
+	emit_comment( "Benchmark of the decoder, compiled in by defining the macro below.", NULL );
+	fprintf( output_source, "#if defined( %s_BENCHMARK )\n", macro );
+	fprintf( output_source, "#include <stdio.h>\n#include <stdlib.h>\n#include <time.h>\n" );
+	fprintf( output_source, "#if !defined( %s_BENCH_BLOCK )\n#define %s_BENCH_BLOCK 256\n#endif\n", macro, macro );
+	fprintf( output_source, "#if !defined( %s_BENCH_DECODES )\n#define %s_BENCH_DECODES 20000000\n#endif\n", macro, macro );
+	fprintf( output_source, "#if !defined( %s_BENCH_RANDOM )\n#define %s_BENCH_RANDOM 1000000\n#endif\n", macro, macro );
+	fprintf( output_source, "static volatile uintptr_t %s_bench_sink;\n", data_name );
+	fprintf( output_source, "static uint64_t %s_bench_state = 0x9E3779B97F4A7C15;\n\n", data_name );
+	/*
+	 *	A uniformly random word (xorshift).
+	 */
+	fprintf( output_source, "static %s %s_bench_random( void ) {\n", w, data_name );
+	fprintf( output_source, "\t%s_bench_state ^= %s_bench_state << 13;\n", data_name, data_name );
+	fprintf( output_source, "\t%s_bench_state ^= %s_bench_state >> 7;\n", data_name, data_name );
+	fprintf( output_source, "\t%s_bench_state ^= %s_bench_state << 17;\n", data_name, data_name );
+	fprintf( output_source, "\treturn(( %s )( %s_bench_state & 0x%" PRIX64 " ));\n", w, data_name, (uint64_t)field_mask( 0, word_size ));
+	fprintf( output_source, "}\n\n" );
+	/*
+	 *	The clock, in nanoseconds.
+	 */
+	fprintf( output_source, "static double %s_bench_now( void ) {\n", data_name );
+	fprintf( output_source, "\tstruct timespec\tt;\n\n" );
+	fprintf( output_source, "\tclock_gettime( CLOCK_MONOTONIC, &t );\n" );
+	fprintf( output_source, "\treturn(( double )t.tv_sec * 1e9 + ( double )t.tv_nsec );\n" );
+	fprintf( output_source, "}\n\n" );
+	fprintf( output_source, "static int %s_bench_order( const void *a, const void *b ) {\n", data_name );
+	fprintf( output_source, "\tdouble\tx = *( const double * )a,\n\t\ty = *( const double * )b;\n\n" );
+	fprintf( output_source, "\treturn(( x > y ) - ( x < y ));\n" );
+	fprintf( output_source, "}\n\n" );
+	/*
+	 *	Timing one stream, after a pass to warm the caches.
+	 */
+	fprintf( output_source, "static void %s_bench_run( const char *name, const %s *opcode, size_t count ) {\n", data_name, w );
+	fprintf( output_source, "\tsize_t\t\tblocks = ( count + %s_BENCH_BLOCK - 1 ) / %s_BENCH_BLOCK,\n", macro, macro );
+	fprintf( output_source, "\t\t\tpasses = ( %s_BENCH_DECODES + count - 1 ) / count,\n", macro );
+	fprintf( output_source, "\t\t\tdecodes = count * passes,\n" );
+	fprintf( output_source, "\t\t\tk = 0;\n" );
+	fprintf( output_source, "\tdouble\t\t*block = ( double * )malloc( sizeof( double ) * blocks * passes ),\n" );
+	fprintf( output_source, "\t\t\ttotal = 0;\n" );
+	fprintf( output_source, "\tuintptr_t\tsink = 0;\n\n" );
+	fprintf( output_source, "\tfor( size_t j = 0; j < count; j++ ) sink += ( uintptr_t )%s;\n", call );
+	fprintf( output_source, "\tfor( size_t p = 0; p < passes; p++ ) {\n" );
+	fprintf( output_source, "\t\tfor( size_t i = 0; i < count; i += %s_BENCH_BLOCK ) {\n", macro );
+	fprintf( output_source, "\t\t\tsize_t\tn = ( count - i < %s_BENCH_BLOCK )? count - i: %s_BENCH_BLOCK;\n", macro, macro );
+	fprintf( output_source, "\t\t\tdouble\tstart = %s_bench_now();\n\n", data_name );
+	fprintf( output_source, "\t\t\tfor( size_t j = i; j < i + n; j++ ) sink += ( uintptr_t )%s;\n", call );
+	fprintf( output_source, "\t\t\tblock[ k ] = %s_bench_now() - start;\n", data_name );
+	fprintf( output_source, "\t\t\ttotal += block[ k ];\n" );
+	fprintf( output_source, "\t\t\tblock[ k++ ] /= n;\n" );
+	fprintf( output_source, "\t\t}\n" );
+	fprintf( output_source, "\t}\n" );
+	fprintf( output_source, "\t%s_bench_sink += sink;\n", data_name );
+	fprintf( output_source, "\tqsort( block, k, sizeof( double ), %s_bench_order );\n", data_name );
+	fprintf( output_source, "\tprintf( \"%%-10s %%12zu %%10.2f %%14.0f %%10.2f %%10.2f\\n\", name, decodes,\n" );
+	fprintf( output_source, "\t\t\ttotal / decodes, decodes * 1e9 / total, block[ k / 2 ], block[( k * 99 ) / 100 ]);\n" );
+	fprintf( output_source, "\tfree( block );\n" );
+	fprintf( output_source, "}\n\n" );
+	/*
+	 *	The streams: every opcode (where there are few enough),
+	 *	random opcodes and a trace of first words.
+	 */
+	fprintf( output_source, "int main( int argc, char *argv[]) {\n" );
+	fprintf( output_source, "\t%s\t*opcode;\n", w );
+	fprintf( output_source, "\tsize_t\tcount;\n\n" );
+	fprintf( output_source, "\tprintf( \"%%-10s %%12s %%10s %%14s %%10s %%10s\\n\", \"stream\", \"decodes\", \"ns/decode\", \"decodes/sec\", \"p50 ns\", \"p99 ns\" );\n" );
+	if(( maximum_words == 1 )&&( word_size <= MAX_FLAT )) {
+		fprintf( output_source, "\tcount = ( size_t )1 << %d;\n", word_size );
+		fprintf( output_source, "\topcode = ( %s * )malloc( sizeof( %s ) * count );\n", w, w );
+		fprintf( output_source, "\tfor( size_t i = 0; i < count; i++ ) opcode[ i ] = ( %s )i;\n", w );
+		fprintf( output_source, "\t%s_bench_run( \"exhaustive\", opcode, count );\n", data_name );
+		fprintf( output_source, "\tfree( opcode );\n" );
+	}
+	fprintf( output_source, "\tcount = %s_BENCH_RANDOM;\n", macro );
+	fprintf( output_source, "\topcode = ( %s * )malloc( sizeof( %s ) * count * %d );\n", w, w, maximum_words );
+	fprintf( output_source, "\tfor( size_t i = 0; i < count * %d; i++ ) opcode[ i ] = %s_bench_random();\n", maximum_words, data_name );
+	fprintf( output_source, "\t%s_bench_run( \"random\", opcode, count );\n", data_name );
+	fprintf( output_source, "\tfree( opcode );\n" );
+	fprintf( output_source, "\tif( argc > 1 ) {\n" );
+	fprintf( output_source, "\t\tFILE\t*trace = fopen( argv[ 1 ], \"rb\" );\n\n" );
+	fprintf( output_source, "\t\tif( trace == NULL ) {\n" );
+	fprintf( output_source, "\t\t\tfprintf( stderr, \"Cannot open trace '%%s'.\\n\", argv[ 1 ]);\n" );
+	fprintf( output_source, "\t\t\treturn( 1 );\n" );
+	fprintf( output_source, "\t\t}\n" );
+	fprintf( output_source, "\t\tfseek( trace, 0, SEEK_END );\n" );
+	fprintf( output_source, "\t\tcount = ( size_t )ftell( trace ) / %d;\n", bytes );
+	fprintf( output_source, "\t\trewind( trace );\n" );
+	fprintf( output_source, "\t\topcode = ( %s * )malloc( sizeof( %s ) * ( count * %d + 1 ));\n", w, w, maximum_words );
+	fprintf( output_source, "\t\tfor( size_t i = 0; i < count * %d; i++ ) {\n", maximum_words );
+	if( maximum_words > 1 ) {
+		fprintf( output_source, "\t\t\tif( i %% %d ) {\n", maximum_words );
+		fprintf( output_source, "\t\t\t\topcode[ i ] = %s_bench_random();\n", data_name );
+		fprintf( output_source, "\t\t\t\tcontinue;\n" );
+		fprintf( output_source, "\t\t\t}\n" );
 	}
-	return( left );
+	fprintf( output_source, "\t\t\topcode[ i ] = 0;\n" );
+	fprintf( output_source, "\t\t\tfor( int b = 0; b < %d; b++ ) opcode[ i ] |= ( %s )getc( trace ) << ( b << 3 );\n", bytes, w );
+	fprintf( output_source, "\t\t\topcode[ i ] &= 0x%" PRIX64 ";\n", (uint64_t)field_mask( 0, word_size ));
+	fprintf( output_source, "\t\t}\n" );
+	fprintf( output_source, "\t\tfclose( trace );\n" );
+	fprintf( output_source, "\t\tif( count ) %s_bench_run( \"trace\", opcode, count );\n", data_name );
+	fprintf( output_source, "\t\tfree( opcode );\n" );
+	fprintf( output_source, "\t}\n" );
+	fprintf( output_source, "\treturn( 0 );\n" );
+	fprintf( output_source, "}\n" );
+	fprintf( output_source, "#endif\n\n" );
+	FREE( macro );
+	FREE( call );
 }
 
 int main( int argc, char *argv[]) {
-	char	buffer[ MAX_BUFFER ],
+	char	*text,
+		*next,
+		*buffer,
 		*record;
+	size_t	size,
+		len;
 	int	line,
-		len,
 		count;
 	FILE	*input;
-	word	mask[ MAX_CODES ];
-	int	table_size;
+	int	table_size,
+		before;
+	NODE	**rows;
+	INSTRUCTION	**order;
+	unsigned long	total_weight;
+	TREE_STATS	stats;
+
+	/*
+	 *	Everything taken from the arenas goes back in one go.
+	 */
+	atexit( release_arenas );
+
+	/*
+	 *	Options ahead of the file name: -j [n] builds the tree
+	 *	with n threads (one per processor if not given), and
+	 *	--stats=json reports on the tree built.
+	 */
+	while(( argc > 1 )&&(( strncmp( argv[ 1 ], "-j", 2 ) == 0 )||( strncmp( argv[ 1 ], "--stats", 7 ) == 0 ))) {
+		int	used = 1;
+
+		if( argv[ 1 ][ 1 ] == '-' ) {
+			if( strcmp( argv[ 1 ] + 7, "=json" )) {
+				fprintf( stderr, "Unsupported statistics '%s' (only --stats=json).\n", argv[ 1 ]);
+				return( 1 );
+			}
+			stats_output = TRUE;
+		}
+		else {
+			/*
+			 *	A count, attached or not, must be all digits,
+			 *	so a file name such as 8086.txt is not taken.
+			 */
+			if( argv[ 1 ][ 2 ]) {
+				build_jobs = ( strspn( argv[ 1 ] + 2, "0123456789" ) == strlen( argv[ 1 ] + 2 ))? atoi( argv[ 1 ] + 2 ): 0;
+			}
+			else {
+				if(( argc > 2 )&&( argv[ 2 ][ 0 ])&&( strspn( argv[ 2 ], "0123456789" ) == strlen( argv[ 2 ]))) {
+					build_jobs = atoi( argv[ 2 ]);
+					used = 2;
+				}
+				else {
+					build_jobs = (int)sysconf( _SC_NPROCESSORS_ONLN );
+				}
+			}
+			if( build_jobs < 1 ) {
+				fprintf( stderr, "Invalid number of build threads.\n" );
+				return( 1 );
+			}
+		}
+		/*
+		 *	Drop the option, keeping the program name.
+		 */
+		argv[ used ] = argv[ 0 ];
+		argc -= used;
+		argv += used;
+	}
+	if(( build_jobs > 1 )&& !start_build()) {
+		fprintf( stderr, "Unable to start %d build threads.\n", build_jobs );
+		return( 1 );
+	}
 
 	switch( argc ) {
 		case 1: {
 			/*
 			 *	Reading from STDIN
 			 */
+			if( stats_output ) {
+				fprintf( stderr, "Statistics need a file name, the output going to stdout otherwise.\n" );
+				return( 1 );
+			}
 			input_source_file = "stdin";
 			input = stdin;
 			output_base_name = NULL;
@@ -1391,10 +6949,12 @@ int main( int argc, char *argv[]) {
 				 */
 				*p = EOS;
 			}
+			output_cache_name = strcatdup( output_base_name, ".cache" );
+			atexit( discard_output );
 			break;
 		}
 		default: {
-			fprintf( stderr, "Usage: %s [{filename}]\n", argv[ 0 ]);
+			fprintf( stderr, "Usage: %s [-j [threads]] [--stats=json] [{filename}]\n", argv[ 0 ]);
 			return( 1 );
 		}
 	}
@@ -1408,170 +6968,183 @@ int main( int argc, char *argv[]) {
 	/*
 	 *	Here we go...
 	 */
+	if(( text = load_input( input, &size )) == NULL ) {
+		fprintf( stderr, "Unable to read '%s'.\n", input_source_file );
+		return( 1 );
+	}
+	input_hash = hash_bytes( input_hash, text, size );
 	line = 0;
-	while( fgets( buffer, MAX_BUFFER, input )) {
+	for( next = text; next < text + size; next += len + 1 ) {
 		line += 1;
-		if(( len = strlen( buffer ))) {
-			/*
-			 *	Check for new line and remove if found.
-			 */
-			len -= 1;
-			if( buffer[ len ] != NL ) {
-				fprintf( stderr, "Line %d too long.\n", line );
-				return( 1 );
-			}
-			buffer[ len ] = EOS;
-			/*
-			 *	Have we got Block Record?  This requires specific
-			 *	handling.
-			 */
-			if(( record = strchr( buffer, BEGIN_RECORD ))) {
-				if( record[ 1 ] == BLOCK_RECORD ) {
-					switch( record[ 2 ] ) {
-						case BLOCK_START: {
-							push_mode( START_MODE, line );
-							break;
-						}
-						case BLOCK_END: {
-							push_mode( END_MODE, line );
-							break;
-						}
-						case BLOCK_HEADER: {
-							push_mode( HEADER_MODE, line );
-							break;
-						}
-						case BLOCK_COMMENT: {
-							push_mode( COMMENT_MODE, line );
-							break;
-						}
-						case SPACE:
-						case TAB:
-						case END_RECORD: {
-							if( !pop_mode()) {
-								fprintf( stderr, "Block ends without corresponding start, line %d.\n", line );
-								return( 1 );
-							}
-							break;
-						}
-						default: {
-							fprintf( stderr, "Invalid Block record in line %d.\n", line );
-							return( 1 );
-						}
+		buffer = next;
+		/*
+		 *	Find the new line and replace it, so the line can
+		 *	be handled as a string where it lies.
+		 */
+		len = (char *)memchr( buffer, NL, text + size - buffer ) - buffer;
+		buffer[ len ] = EOS;
+		/*
+		 *	Have we got Block Record?  This requires specific
+		 *	handling.
+		 */
+		if(( record = strchr( buffer, BEGIN_RECORD ))) {
+			if( record[ 1 ] == BLOCK_RECORD ) {
+				switch( record[ 2 ] ) {
+					case BLOCK_START: {
+						push_mode( START_MODE, line );
+						break;
 					}
-					/*
-					 *	getting here means we have had a valid
-					 *	block command.  as the actual line itself
-					 *	has no other meaning or purpose we skip
-					 *	all the line processing code.
-					 */
-					output_target = UNSPECIFIED_TARGET;
-					/*
-					 *	Force loop to start next input line processing.
-					 */
-					continue;
-				}
-			}
-			/*
-			 *	How we operate is dependent on the block mode..
-			 */
-			if( root_block_stack ) {
-				/*
-				 *	We are in a block mode..
-				 */
-				switch( root_block_stack->mode ) {
-					case START_MODE: {
-						/*
-						 *	Output data to the start of the source file.
-						 */
-						if( output_target != SOURCE_TARGET ) {
-							output_target = SOURCE_TARGET;
-							fprintf( output_source, "#line %d \"%s\"\n", line, input_source_file );
-						}
-						fprintf( output_source, "%s\n", buffer );
+					case BLOCK_END: {
+						push_mode( END_MODE, line );
+						break;
+					}
+					case BLOCK_HEADER: {
+						push_mode( HEADER_MODE, line );
 						break;
 					}
-					case END_MODE: {
-						/*
-						 *	Output data to the end of the source file.
-						 */
-						output_target = UNSPECIFIED_TARGET;
-						FINISH *ptr = NEW( FINISH );
-						ptr->line = line;
-						ptr->data = DUP( buffer );
-						ptr->next = NULL;
-						*finish_data_tail = ptr;
-						finish_data_tail = &( ptr->next );
+					case BLOCK_COMMENT: {
+						push_mode( COMMENT_MODE, line );
 						break;
 					}
-					case HEADER_MODE: {
-						/*
-						 *	Output data to the header file.
-						 */
-						if( output_target != HEADER_TARGET ) {
-							output_target = HEADER_TARGET;
-							fprintf( output_header, "#line %d \"%s\"\n", line, input_source_file );
+					case SPACE:
+					case TAB:
+					case END_RECORD: {
+						if( !pop_mode()) {
+							fprintf( stderr, "Block ends without corresponding start, line %d.\n", line );
+							return( 1 );
 						}
-						fprintf( output_header, "%s\n", buffer );
 						break;
 					}
 					default: {
-						/*
-						 *	Following lines are just comments, free form
-						 * 	text to be ignored.
-						 */
-						 output_target = UNSPECIFIED_TARGET;
-						 break;
+						fprintf( stderr, "Invalid Block record in line %d.\n", line );
+						return( 1 );
 					}
 				}
-			}
-			else {
 				/*
-				 * 	No mode stack means we are in line mode.
-				 * 
-				 *	Contains a record?
+				 *	getting here means we have had a valid
+				 *	block command.  as the actual line itself
+				 *	has no other meaning or purpose we skip
+				 *	all the line processing code.
 				 */
-				if( record ) {
-					char	*q;
-
+				output_target = UNSPECIFIED_TARGET;
+				/*
+				 *	Force loop to start next input line processing.
+				 */
+				continue;
+			}
+		}
+		/*
+		 *	How we operate is dependent on the block mode..
+		 */
+		if( root_block_stack ) {
+			/*
+			 *	We are in a block mode..
+			 */
+			switch( root_block_stack->mode ) {
+				case START_MODE: {
 					/*
-					 *	Skip record start.
+					 *	Output data to the start of the source file.
 					 */
-					record++;
+					if( output_target != SOURCE_TARGET ) {
+						flush_pass();
+						output_target = SOURCE_TARGET;
+						fprintf( output_source, "#line %d \"%s\"\n", line, input_source_file );
+					}
+					buffer[ len ] = NL;
+					pass_line( output_source, buffer, len + 1 );
+					break;
+				}
+				case END_MODE: {
 					/*
-					 *	Is there an optional record end (remember we have
-					 *	to watch out for escaped end symbols).
+					 *	Output data to the end of the source file.
 					 */
-					q = record;
-					while(( q = strchr( q, END_RECORD ))) {
-						if( *(q-1) != ESCAPE_SYMBOL ) {
-							*q++ = EOS;
-							break;
-						}
-						/*
-						 *	Strip escape and look again.
-						 */
-						*(q-1) = END_RECORD;
-						strcpy( q, q+1 );
+					output_target = UNSPECIFIED_TARGET;
+					FINISH *ptr = (FINISH *)arena_alloc( &record_arena, sizeof( FINISH ), ARENA_ALIGN );
+					ptr->line = line;
+					ptr->data = buffer;
+					ptr->length = len;
+					ptr->next = NULL;
+					*finish_data_tail = ptr;
+					finish_data_tail = &( ptr->next );
+					break;
+				}
+				case HEADER_MODE: {
+					/*
+					 *	Output data to the header file.
+					 */
+					if( output_target != HEADER_TARGET ) {
+						flush_pass();
+						output_target = HEADER_TARGET;
+						fprintf( output_header, "#line %d \"%s\"\n", line, input_source_file );
 					}
-					if( q == NULL ) {
-						q = "";
+					buffer[ len ] = NL;
+					pass_line( output_header, buffer, len + 1 );
+					break;
+				}
+				default: {
+					/*
+					 *	Following lines are just comments, free form
+					 * 	text to be ignored.
+					 */
+					 output_target = UNSPECIFIED_TARGET;
+					 break;
+				}
+			}
+		}
+		else {
+			/*
+			 * 	No mode stack means we are in line mode.
+			 * 
+			 *	Contains a record?
+			 */
+			if( record ) {
+				char	*q;
+
+				/*
+				 *	Skip record start.
+				 */
+				record++;
+				/*
+				 *	Is there an optional record end (remember we have
+				 *	to watch out for escaped end symbols).
+				 */
+				q = record;
+				while(( q = strchr( q, END_RECORD ))) {
+					if( *(q-1) != ESCAPE_SYMBOL ) {
+						*q++ = EOS;
+						break;
 					}
 					/*
-					 *	Process this line from after the
-					 *	begin symbol.
+					 *	Strip escape and look again.
 					 */
-					if( !process( line, record, q )) {
-						fprintf( stderr, "Error in line %d.\n", line );
-						return( 1 );
-					}		
+					*(q-1) = END_RECORD;
+					memmove( q, q+1, strlen( q+1 ) + 1 );
 				}
-				else {
-					output_target = UNSPECIFIED_TARGET;
+				if( q == NULL ) {
+					q = "";
 				}
+				/*
+				 *	Anything passed through so far must go
+				 *	out before the record can add to it.
+				 */
+				flush_pass();
+				/*
+				 *	Process this line from after the
+				 *	begin symbol.
+				 */
+				if( !process( line, record, q )) {
+					fprintf( stderr, "Error in line %d.\n", line );
+					return( 1 );
+				}		
+			}
+			else {
+				output_target = UNSPECIFIED_TARGET;
 			}
 		}
 	}
 	
+	flush_pass();
+
 	/*
 	 * 	If the block mode stack is not empty then there is an error.
 	 */
@@ -1584,6 +7157,15 @@ int main( int argc, char *argv[]) {
 		return( 1 );
 	}
 
+	/*
+	 *	The statistics are written to the standard output, so the
+	 *	source must have gone to a file.
+	 */
+	if( stats_output &&( output_source == stdout )) {
+		fprintf( stderr, "Statistics need an L record, the output going to stdout otherwise.\n" );
+		return( 1 );
+	}
+
 	/*
 	 *	Fill in missing output information if not supplied.
 	 */
@@ -1594,65 +7176,359 @@ int main( int argc, char *argv[]) {
 	if( data_name == NULL ) data_name = "decoder";
 		
 	/*
-	 *	Calculate how many instructions have been captured.
+	 *	Calculate how many instructions have been captured,
+	 *	numbering them as we go.
 	 */
 	count = 0;
-	for( INSTRUCTION *ptr = instructions; ptr; ptr = ptr->next ) count++;
-	
+	for( INSTRUCTION *ptr = instructions; ptr; ptr = ptr->next ) ptr->id = ++count;
+	order = (INSTRUCTION **)malloc( sizeof( INSTRUCTION * ) * ( count + 1 ));
+	for( INSTRUCTION *ptr = instructions; ptr; ptr = ptr->next ) order[ ptr->id - 1 ] = ptr;
+
 	/*
-	 *	Get on and insert instructions into the tree.
+	 *	Find out how often the instructions are executed.
 	 */
-	for( int i = 0; i < MAX_CODES; mask[ i++ ] = ~((word)0));
-	tree = insert( mask, instructions, count );
+	apply_rates();
+	if( trace_file && !read_trace( trace_file )) return( 1 );
+	total_weight = 0;
+	for( INSTRUCTION *ptr = instructions; ptr; ptr = ptr->next ) total_weight += ptr->weight;
 
 	/*
-	 *	Assign sequenced index numbers to the nodes
+	 *	Can the output mode handle this instruction set?
 	 */
-	table_size = sequence( tree, 0 );
+	field_rows = ( field_bits > 1 )||( table_layout != DEPTH_LAYOUT )||( unroll_walk );
+	if( invert_tests && field_rows ) {
+		fprintf( stderr, "Inverted tests need the one bit table layout.\n" );
+		return( 1 );
+	}
+	if( invert_tests && packed_output ) {
+		fprintf( stderr, "Inverted tests cannot be packed.\n" );
+		return( 1 );
+	}
+	if( share_subtrees &&(( table_layout != DEPTH_LAYOUT )|| unroll_walk )) {
+		fprintf( stderr, "Shared subtrees need the depth layout, without an unrolled walk.\n" );
+		return( 1 );
+	}
+	if( unroll_walk &&( packed_output ||( output_mode != TABLE_OUTPUT ))) {
+		fprintf( stderr, "Unrolled walks need the (unpacked) table output mode.\n" );
+		return( 1 );
+	}
+	if( batch_output &&(( output_mode != ARRAYS_OUTPUT )||( maximum_words != 1 ))) {
+		fprintf( stderr, "Batch decoding requires the arrays output mode and a W record of 1.\n" );
+		return( 1 );
+	}
+	if( batch_output &&( word_size > 32 )) {
+		fprintf( stderr, "Batch decoding gathers 32 bit lanes, so needs a word size of at most 32.\n" );
+		return( 1 );
+	}
+	if( lazy_fetch &&(( maximum_words < 2 )|| packed_output ||(( output_mode != TABLE_OUTPUT )&&( output_mode != ARRAYS_OUTPUT )))) {
+		fprintf( stderr, "Lazy fetching requires a W record above 1 and the (unpacked) table or arrays output mode.\n" );
+		return( 1 );
+	}
+	if(( predecode_cache || operand_output || dispatch_form || lazy_fetch )&& constexpr_output &&( output_mode == TABLE_OUTPUT )&& !packed_output ) {
+		fprintf( stderr, "A predecode cache, operands, dispatch or fetching cannot be found from a constexpr table.\n" );
+		return( 1 );
+	}
+	if( packed_output &&( output_mode != TABLE_OUTPUT )) {
+		fprintf( stderr, "Packed output requires the table output mode.\n" );
+		return( 1 );
+	}
+	if( constexpr_output && !output_cpp ) {
+		fprintf( stderr, "Constexpr output requires an L record of C++.\n" );
+		return( 1 );
+	}
+	if( output_mode == TRIE_OUTPUT ) {
+		int	total = 0;
 
+		if( maximum_words != 1 ) {
+			fprintf( stderr, "Trie output requires a W record of 1.\n" );
+			return( 1 );
+		}
+		for( int l = 0; l < trie_given; total += trie_width[ l++ ]);
+		if( trie_given && ( total != word_size )) {
+			fprintf( stderr, "Trie levels cover %d bits, word size is %d.\n", total, word_size );
+			return( 1 );
+		}
+	}
+	if( output_mode == FLAT_OUTPUT ) {
+		if( maximum_words != 1 ) {
+			fprintf( stderr, "Flat output requires a W record of 1.\n" );
+			return( 1 );
+		}
+		if( word_size > MAX_FLAT ) {
+			fprintf( stderr, "Word size %d too large for flat output (maximum is %d).\n", word_size, MAX_FLAT );
+			return( 1 );
+		}
+		if( word_size > WARN_FLAT ) {
+			fprintf( stderr, "Warning: flat output of word size %d needs %ld entries.\n", word_size, 1L << word_size );
+		}
+	}
+	
 	/*
-	 *	Display the decode tree as an organised array
+	 *	Is there anything to do?  The input hash covers every line
+	 *	read (line numbers reach the output through #line), the
+	 *	trace file and this program itself, read back from its own
+	 *	executable (a build timestamp can be pinned by reproducible
+	 *	builds, so is no guide).  Without that there is no cache.
+	 *	If the cache file holds the same hash and the outputs are as
+	 *	they were left, the tree and table would come out the same
+	 *	again (but the statistics need the tree).
 	 */
-	if( strlen( output_comment_b )) {
-		/*
-		 *	C style start to end comments
-		 */
-		fprintf( output_source, "%s\n", output_comment_a );
-		fprintf( output_source, "\tStart Of Table\n" );
-		fprintf( output_source, "\t==============\n" );
-		fprintf( output_source, "%s\n", output_comment_b );
+	if( output_cache_name && output_header_temp && output_source_temp &&( dropped == 0 )) {
+		input_hash = hash_bytes( input_hash, input_source_file, strlen( input_source_file ) + 1 );
+		if( hash_file( "/proc/self/exe", &input_hash ) &&(( trace_file == NULL )|| hash_file( trace_file, &input_hash ))) {
+			if( !stats_output && cache_current( input_hash )) {
+				fclose( output_header );
+				fclose( output_source );
+				discard_output();
+				fprintf( stderr, "Output of '%s' is up to date.\n", input_source_file );
+				return( 0 );
+			}
+		}
+		else {
+			FREE( output_cache_name );
+			output_cache_name = NULL;
+		}
 	}
 	else {
+		output_cache_name = NULL;
+	}
+
+	/*
+	 *	Get on and insert instructions into the tree, first
+	 *	trying each strategy if asked to.
+	 */
+	weighted = ( total_weight > 0 );
+	if( split_strategy == ALL_STRATEGIES ) {
+		COST	best,
+			cost;
+		int	pick = BALANCE_STRATEGY;
+
+		trial_build = TRUE;
+		for( int i = BALANCE_STRATEGY; i < ALL_STRATEGIES; i++ ) {
+			split_strategy = i;
+			measure( build( order, count ), count, &cost );
+			report_cost( strategy_name[ i ], &cost );
+			if(( i == BALANCE_STRATEGY )|| cheaper( &cost, &best )) {
+				best = cost;
+				pick = i;
+			}
+		}
+		trial_build = FALSE;
+		split_strategy = pick;
+		fprintf( stderr, "Using the %s strategy for the %s objective.\n", strategy_name[ pick ], objective_name[ split_objective ]);
+	}
+	if( total_weight ) {
+		unsigned long	*weight;
+		NODE		*balanced;
+
 		/*
-		 *	C++ style start to end comments
-		 */
-		fprintf( output_source, "%s\n", output_comment_a );
-		fprintf( output_source, "%s\tStart Of Table\n", output_comment_a );
-		fprintf( output_source, "%s\t==============\n", output_comment_a );
-		fprintf( output_source, "%s\n", output_comment_a );
-	}
-	fprintf( output_source, "%s %s %s[ %d ] = {\n", data_scope, data_type, data_name, table_size );
-	(void)emit_decoder( tree, table_size );
-	fprintf( output_source, "};\n" );
-	fprintf( output_source, "\n" );
-	if( strlen( output_comment_b )) {
-		/*
-		 *	C style start to end comments
+		 *	Build the tree without the weights first, to
+		 *	measure the weighted tree against.
 		 */
-		fprintf( output_source, "%s\n", output_comment_a );
-		fprintf( output_source, "\tEnd Of Table\n" );
-		fprintf( output_source, "\t============\n" );
-		fprintf( output_source, "%s\n", output_comment_b );
+		weight = (unsigned long *)malloc( sizeof( unsigned long ) * count );
+		for( int i = 0; i < count; i++ ) {
+			weight[ i ] = order[ i ]->weight;
+			order[ i ]->weight = 0;
+		}
+		trial_build = TRUE;
+		weighted = FALSE;
+		balanced = build( order, count );
+		weighted = TRUE;
+		trial_build = FALSE;
+		for( int i = 0; i < count; i++ ) order[ i ]->weight = weight[ i ];
+		FREE( weight );
+		tree = build( order, count );
+		fprintf( stderr, "Expected walk %.3f rows weighted by frequency (%.3f rows without weights).\n",
+				weighted_walk( tree, count ) / total_weight,
+				weighted_walk( balanced, count ) / total_weight );
 	}
 	else {
-		/*
-		 *	C++ style start to end comments
-		 */
-		fprintf( output_source, "%s\n", output_comment_a );
-		fprintf( output_source, "%s\tEnd Of Table\n", output_comment_a );
-		fprintf( output_source, "%s\t============\n", output_comment_a );
-		fprintf( output_source, "%s\n", output_comment_a );
+		tree = build( order, count );
+	}
+	if( strategy_set ) {
+		COST	cost;
+
+		measure( tree, count, &cost );
+		report_cost( strategy_name[ split_strategy ], &cost );
+	}
+	if( lazy_fetch ) {
+		double	total = 0.0,
+			words = words_fetched( tree, 0, 1.0, &total );
+
+		fprintf( stderr, "Lazy fetching reads %.3f of up to %d words per decode.\n", ( total > 0.0 )? words / total: 0.0, maximum_words );
+	}
+	if( stats_output ) tree_stats( tree, count, &stats );
+
+	emit_comment( "Start Of Table", "==============", NULL );
+	if( constexpr_output ) fprintf( output_source, "#include <array>\n" );
+	switch( output_mode ) {
+		case FLAT_OUTPUT: {
+			/*
+			 *	Every opcode gets looked up in the tree.
+			 */
+			if( deepest_word( tree ) >= maximum_words ) {
+				fprintf( stderr, "Maximum words value exceeded in flat table.\n" );
+				dropped++;
+			}
+			emit_flat( tree, count );
+			break;
+		}
+		case TRIE_OUTPUT: {
+			/*
+			 *	Opcodes are looked up a level at a time.
+			 */
+			if( deepest_word( tree ) >= maximum_words ) {
+				fprintf( stderr, "Maximum words value exceeded in trie.\n" );
+				dropped++;
+			}
+			emit_trie( tree, count );
+			break;
+		}
+		case CODE_OUTPUT: {
+			/*
+			 *	The tree becomes the code of the routine.
+			 */
+			emit_code( tree, count );
+			break;
+		}
+		case ARRAYS_OUTPUT: {
+			/*
+			 *	Nodes, children and values in separate arrays.
+			 */
+			emit_arrays( tree, count );
+			break;
+		}
+		default: {
+			/*
+			 *	Assign sequenced index numbers to the nodes and
+			 *	lay them out as the rows of the table.
+			 */
+			before = 0;
+			if( share_subtrees ) {
+				/*
+				 *	Fold identical subtrees together, counting
+				 *	the rows of the same layout unshared first.
+				 */
+				before = ( field_rows )? layout_fields( tree, table_layout ): count_rows( tree );
+				tree = share( tree );
+			}
+			if( field_rows ) {
+				if( table_layout == ALL_LAYOUTS ) {
+					double	best = 0.0,
+						lines;
+					int	pick = DEPTH_LAYOUT;
+
+					/*
+					 *	Measure each layout, keeping the one
+					 *	reading the fewest cache lines.
+					 */
+					for( int i = DEPTH_LAYOUT; i < ALL_LAYOUTS; i++ ) {
+						lines = report_layout( layout_name[ i ], tree, layout_fields( tree, i ));
+						if(( i == DEPTH_LAYOUT )||( lines < best )) {
+							best = lines;
+							pick = i;
+						}
+					}
+					table_layout = pick;
+					layout_set = FALSE;
+					fprintf( stderr, "Using the %s layout.\n", layout_name[ pick ]);
+				}
+				tree->index = 0;
+				table_size = layout_fields( tree, table_layout );
+				rows = (NODE **)malloc( sizeof( NODE * ) * table_size );
+				for( int i = 0; i < table_size; rows[ i++ ] = NULL );
+				rows[ 0 ] = tree;
+				place_fields( rows, tree );
+				/*
+				 *	Fill any gaps left between cache lines.
+				 */
+				for( int i = 0; i < table_size; i++ ) if( rows[ i ] == NULL ) rows[ i ] = new_node( NULL, 0, 0, 0 );
+			}
+			else {
+				rows = (NODE **)malloc( sizeof( NODE * ) * count_rows( tree ));
+				if( invert_tests ) choose_fall( tree, rows );
+				table_size = sequence_rows( rows, tree );
+			}
+			if( layout_set ) {
+				char	name[ MAX_BUFFER ];
+
+				sprintf( name, "%s%s", layout_name[ table_layout ], ( invert_tests )? " inverted": "" );
+				report_layout( name, tree, table_size );
+			}
+			if( unroll_walk ) {
+				char	note[ MAX_BUFFER ];
+
+				walk_steps = tree_height( tree );
+				sprintf( note, "The unrolled walk takes %d steps (loads) for every opcode.", walk_steps );
+				fprintf( stderr, "%s\n", note );
+				emit_comment( note, NULL );
+			}
+			if( share_subtrees ) {
+				char	note[ MAX_BUFFER ];
+
+				sprintf( note, "Sharing identical subtrees cuts the table from %d to %d rows.", before, table_size );
+				fprintf( stderr, "%s\n", note );
+				emit_comment( note, NULL );
+			}
+
+			/*
+			 *	Display the decode tree as an organised array
+			 */
+			if( packed_output ) {
+				/*
+				 *	The rows become packed entries.
+				 */
+				emit_packed( rows, table_size, count );
+				break;
+			}
+			table_entries = table_size;
+			table_entry_bytes = row_bytes;
+			table_bytes = (long)table_size * row_bytes;
+			if( constexpr_output ) {
+				char	*type = new_text( 1 );
+
+				/*
+				 *	Rows of a generated literal type walked by
+				 *	a generated constexpr routine.
+				 */
+				emit_row_type( rows, table_size );
+				sprintf( type, "%s_row", data_name );
+				emit_array_open( "", type, data_name, table_size, align_table );
+				FREE( type );
+			}
+			else {
+				emit_array_open( "", data_type, data_name, table_size, align_table );
+			}
+			for( int i = 0; i < table_size; i++ ) emit_decoder( rows[ i ], i, ( i == table_size-1 ));
+			emit_array_close();
+			fprintf( output_source, "\n" );
+			if( constexpr_output ) {
+				emit_row_find();
+			}
+			else {
+				/*
+				 *	The one bit table's walk is left to the
+				 *	user, unless the predecode cache, the
+				 *	operand lookup, dispatch or benchmark
+				 *	needs it.
+				 */
+				if( field_rows || predecode_cache || operand_output || dispatch_form || benchmark_output ) emit_table_find();
+			}
+			if( operand_output ) emit_operands( rows, table_size, order, count );
+			if( predecode_cache ) emit_predecode( rows, table_size, order, count );
+			if( lazy_fetch ) emit_table_fetch( rows, table_size, order, count );
+			if( dispatch_form ) emit_dispatch( rows, table_size, order, count );
+			if( benchmark_output ) emit_benchmark();
+			break;
+		}
 	}
+	if(( output_mode != TABLE_OUTPUT )|| packed_output ) {
+		if( operand_output ) emit_operands( NULL, 0, order, count );
+		if( predecode_cache ) emit_predecode( NULL, 0, order, count );
+		if( dispatch_form ) emit_dispatch( NULL, 0, order, count );
+		if( benchmark_output ) emit_benchmark();
+	}
+	emit_comment( "End Of Table", "============", NULL );
 
 	/*
 	 * 	Output all of the finish data.. We will re-use the line variable
@@ -1664,7 +7540,8 @@ int main( int argc, char *argv[]) {
 			fprintf( output_source, "#line %d \"%s\"\n", finish_data->line, input_source_file );
 			line = finish_data->line + 1;
 		}
-		fprintf( output_source, "%s\n", finish_data->data );
+		fwrite( finish_data->data, 1, finish_data->length, output_source );
+		fputc( NL, output_source );
 		finish_data = finish_data->next;
 	}
 
@@ -1675,10 +7552,19 @@ int main( int argc, char *argv[]) {
 		fprintf( stderr, "\nERROR!\n\n\t%d errors detected in configuration data.\n\n", dropped );
 	}
 
-	if( output_base_name ) {
+	if( output_header_temp && output_source_temp ) {
+		bool	written;
+
 		fclose( output_header );
 		fclose( output_source );
+		written = commit_output( output_header_name, output_header_temp );
+		written = commit_output( output_source_name, output_source_temp ) && written;
+		output_header_temp = NULL;
+		output_source_temp = NULL;
+		if( !written ) return( 1 );
+		if( output_cache_name &&( dropped == 0 )) write_cache( input_hash );
 	}
+	if( stats_output ) write_stats( &stats, order, count, total_weight );
 	
 	/*
 	 *	Done